@@ -0,0 +1,87 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_ALIGNED_ALLOCATOR_H_
+#define VT_ALIGNED_ALLOCATOR_H_
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <new>
+#include <utility>
+
+namespace vt {
+
+// stl allocator returning storage aligned for simd loads
+template<class T, size_t Alignment>
+class aligned_allocator
+{
+public:
+    typedef T         value_type;
+    typedef T*        pointer;
+    typedef const T*  const_pointer;
+    typedef T&        reference;
+    typedef const T&  const_reference;
+    typedef size_t    size_type;
+    typedef ptrdiff_t difference_type;
+
+    template<class U>
+    struct rebind
+    {
+        typedef aligned_allocator<U, Alignment> other;
+    };
+
+    aligned_allocator() {}
+    template<class U>
+    aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+    pointer allocate(size_type n, const void* hint = NULL)
+    {
+        void* p = NULL;
+        if(posix_memalign(&p, Alignment, n * sizeof(T))) {
+            throw std::bad_alloc();
+        }
+        return static_cast<pointer>(p);
+    }
+    void deallocate(pointer p, size_type n)
+    {
+        free(p);
+    }
+    size_type max_size() const
+    {
+        return static_cast<size_type>(-1) / sizeof(T);
+    }
+    template<class U, class... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+    template<class U>
+    void destroy(U* p)
+    {
+        p->~U();
+    }
+};
+
+template<class T, class U, size_t Alignment>
+bool operator==(const aligned_allocator<T, Alignment>&, const aligned_allocator<U, Alignment>&) { return true; }
+
+template<class T, class U, size_t Alignment>
+bool operator!=(const aligned_allocator<T, Alignment>&, const aligned_allocator<U, Alignment>&) { return false; }
+
+}
+
+#endif
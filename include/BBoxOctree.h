@@ -0,0 +1,145 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_BBOX_OCTREE_H_
+#define VT_BBOX_OCTREE_H_
+
+#include <Util.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+#include <string>
+
+namespace vt {
+
+class Mesh;
+
+typedef std::pair<long, long> id_pair_t;
+
+class BBoxOctree;
+
+struct bbox_octree_object_t
+{
+    Mesh*       m_mesh;
+    glm::vec3   m_min;             // world-space aabb
+    glm::vec3   m_max;
+    glm::mat4   m_transform;       // cached to detect transform changes
+    glm::mat4   m_inverse_transform;
+    glm::vec3   m_local_min;       // cached to detect bbox changes
+    glm::vec3   m_local_max;
+    BBoxOctree* m_node;
+};
+
+// broadphase octree of mesh world-space aabbs
+// each object lives in the deepest node that fully contains its aabb (objects outside the root live in the root)
+// NOTE: aabbs are conservative; follow up with BBoxObject::is_bbox_collide for an exact test
+class BBoxOctree
+{
+public:
+    BBoxOctree(glm::vec3   origin,
+               glm::vec3   dim,
+               int         index  = -1,
+               int         depth  = 0,
+               BBoxOctree* parent = NULL,
+               BBoxOctree* root   = NULL);
+    virtual ~BBoxOctree();
+    void clear();
+    void prune_empty_nodes();
+
+    glm::vec3   get_origin() const            { return m_origin; }
+    glm::vec3   get_dim() const               { return m_dim; }
+    int         get_index() const             { return m_index; }
+    int         get_depth() const             { return m_depth; }
+    BBoxOctree* get_node(int index) const     { return m_nodes[index]; }
+    BBoxOctree* get_parent() const            { return m_parent; }
+    BBoxOctree* get_root() const              { return m_root; }
+    int         get_child_count() const       { return m_child_count; }
+    bool        is_leaf() const               { return !m_child_count; }
+    bool        is_root() const               { return !m_parent; }
+    size_t      get_node_object_count() const { return m_node_objects.size(); }
+    size_t      get_object_count() const      { return m_root->m_objects.size(); }
+
+    bool insert(long id, Mesh* mesh);
+    bool remove(long id);
+    bool exists(long id) const;
+    Mesh* get_mesh(long id) const;
+    bool get_min_max(long id, glm::vec3* min, glm::vec3* max) const;
+
+    // re-derive world aabbs of objects whose transform or bbox changed; returns number of objects updated
+    int update();
+    bool update(long id);
+
+    int find_overlaps(glm::vec3          min,
+                      glm::vec3          max,
+                      std::vector<long>* overlap_ids) const;
+    int find_overlap_pairs(std::vector<id_pair_t>* overlap_pairs) const;
+
+    // first hit along ray, visiting octants front-to-back and testing only objects in visited cells
+    // NOTE: tests use transforms cached by the last insert/update, so concurrent queries never touch meshes
+    bool raycast(glm::vec3  ray_origin,
+                 glm::vec3  ray_dir,
+                 float      max_dist   = BIG_NUMBER,
+                 long*      hit_id     = NULL,
+                 float*     hit_dist   = NULL,
+                 glm::vec3* hit_normal = NULL) const;
+    bool segment_query(glm::vec3  p1,
+                       glm::vec3  p2,
+                       long*      hit_id     = NULL,
+                       float*     hit_dist   = NULL,
+                       glm::vec3* hit_normal = NULL) const;
+
+    std::string get_name() const;
+    void dump() const;
+
+private:
+    void insert_hier(long id, bbox_octree_object_t* object);
+    void remove_from_node(long id);
+    void find_overlaps_hier(glm::vec3          min,
+                            glm::vec3          max,
+                            std::vector<long>* overlap_ids) const;
+    void find_overlap_pairs_hier(std::vector<long>*      ancestor_ids,
+                                 std::vector<id_pair_t>* overlap_pairs) const;
+    void raycast_hier(glm::vec3  ray_origin,
+                      glm::vec3  ray_dir,
+                      glm::vec3  inv_ray_dir,
+                      long*      hit_id,
+                      float*     hit_dist,
+                      glm::vec3* hit_normal) const;
+    BBoxOctree* alloc_octant(int octant_index);
+    int get_octant_index(glm::vec3 min, glm::vec3 max) const;
+    bool within_bbox(glm::vec3 min, glm::vec3 max) const;
+    bool is_overlap(glm::vec3 min, glm::vec3 max) const;
+    static bool is_aabb_overlap(glm::vec3 min, glm::vec3 max, glm::vec3 other_min, glm::vec3 other_max);
+    static float ray_aabb_entry_dist(glm::vec3 min, glm::vec3 max, glm::vec3 ray_origin, glm::vec3 inv_ray_dir);
+    static bool calc_world_min_max(Mesh* mesh, bbox_octree_object_t* object);
+
+    glm::vec3                            m_origin;
+    glm::vec3                            m_dim;
+    glm::vec3                            m_center;
+    int                                  m_index;
+    int                                  m_depth;
+    BBoxOctree*                          m_nodes[8];
+    BBoxOctree*                          m_parent;
+    BBoxOctree*                          m_root;
+    int                                  m_child_count;
+    std::vector<long>                    m_node_objects;
+    std::map<long, bbox_octree_object_t> m_objects; // root only
+};
+
+}
+
+#endif
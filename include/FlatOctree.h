@@ -0,0 +1,60 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_FLAT_OCTREE_H_
+#define VT_FLAT_OCTREE_H_
+
+#include <SpatialIndex.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vt {
+
+// pointer-free octree node; children are stored contiguously in the node table
+struct flat_octree_node_t
+{
+    glm::vec3 m_min;         // tight bounds of all points in subtree
+    glm::vec3 m_max;
+    int       m_begin;       // range of own points (empty for nodes that only hold children)
+    int       m_end;
+    int       m_first_child; // index into node table
+    int       m_child_count;
+};
+
+// read-only queries over a flattened octree (node 0 is root); shared by LinearOctree and OctreeSnapshot
+// NOTE: ids and positions are parallel arrays indexed by the node point ranges
+int flat_octree_find(const std::vector<flat_octree_node_t>& node_table,
+                     const std::vector<long>&               ids,
+                     const std::vector<glm::vec3>&          positions,
+                     glm::vec3                              target,
+                     int                                    k,
+                     float                                  radius,
+                     std::vector<id_dist_t>*                nearest_k_heap, // scratch
+                     long*                                  nearest_k_ids); // out: sorted ascending
+int flat_octree_find_within_radius(const std::vector<flat_octree_node_t>& node_table,
+                                   const std::vector<long>&               ids,
+                                   const std::vector<glm::vec3>&          positions,
+                                   glm::vec3                              target,
+                                   float                                  radius,
+                                   long*                                  result_ids,     // out: unsorted
+                                   int                                    capacity,
+                                   float*                                 dists_squared); // out: optional
+void flat_octree_dump(const std::vector<flat_octree_node_t>& node_table);
+
+}
+
+#endif
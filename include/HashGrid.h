@@ -0,0 +1,103 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_HASH_GRID_H_
+#define VT_HASH_GRID_H_
+
+#include <SpatialIndex.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace vt {
+
+// uniform grid over a fixed box; objects outside the box are clamped into border cells
+// NOTE: moves within a cell update in place; other changes mark the grid dirty and
+//       cell buckets are rebuilt (counting sort) by rebalance() or lazily by the next query
+// NOTE: concurrent const queries are safe; writers must not race with readers
+class HashGrid : public SpatialIndex
+{
+public:
+    HashGrid(glm::vec3 origin,
+             glm::vec3 dim,
+             float     cell_size);
+    virtual ~HashGrid();
+    void clear();
+
+    glm::vec3  get_origin() const       { return m_origin; }
+    glm::vec3  get_dim() const          { return m_dim; }
+    float      get_cell_size() const    { return m_cell_size; }
+    glm::ivec3 get_cell_count() const   { return m_cell_count; }
+    size_t     get_object_count() const { return m_ids.size(); }
+
+    bool insert(long id, glm::vec3 pos);
+    bool remove(long id);
+    int find(glm::vec3          target,
+             int                k,
+             std::vector<long>* nearest_k_vec,
+             float              radius = -1) const;
+    int find_batch(const glm::vec3* targets,
+                   size_t           n,
+                   int              k,
+                   float            radius,
+                   long*            nearest_k_ids,            // out: n * k capacity
+                   int*             nearest_k_offsets) const; // out: n + 1 csr offsets
+    int find_within_radius(glm::vec3 target,
+                           float     radius,
+                           long*     ids,                           // out: unsorted
+                           int       capacity,
+                           float*    dists_squared = NULL) const;   // out: optional
+    bool exists(long id);
+    bool move(long id, glm::vec3 pos);
+    bool rebalance();
+
+    void dump() const;
+
+private:
+    int find_into(glm::vec3               target,
+                  int                     k,
+                  float                   radius,
+                  std::vector<id_dist_t>* nearest_k_heap, // scratch
+                  long*                   nearest_k_ids) const; // out
+    void build_if_dirty() const;
+    void build() const;
+    glm::ivec3 get_cell_coord(glm::vec3 pos) const;
+    int get_cell_index(glm::ivec3 cell_coord) const;
+
+    glm::vec3  m_origin;
+    glm::vec3  m_dim;
+    float      m_cell_size;
+    glm::ivec3 m_cell_count;
+
+    // per object, indexed by slot
+    std::vector<long>             m_ids;
+    std::vector<glm::vec3>        m_positions;
+    std::vector<int>              m_cells;
+    std::unordered_map<long, int> m_slots;
+
+    // slots bucketed by cell after build
+    mutable std::vector<int>  m_cell_offsets; // cell count + 1
+    mutable std::vector<int>  m_cell_slots;
+    mutable std::atomic<bool> m_is_dirty;
+    mutable std::mutex        m_build_mutex; // serializes lazy builds from const queries
+};
+
+}
+
+#endif
@@ -0,0 +1,125 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_INDEXED_HEAP_H_
+#define VT_INDEXED_HEAP_H_
+
+#include <stddef.h>
+#include <vector>
+
+namespace vt {
+
+// binary min-heap over ids [0, n) with a position table for O(log n) decrease-key
+// NOTE: reset() only touches ids still queued, so reuse across queries stays cheap
+class IndexedHeap
+{
+public:
+    void reset(size_t n)
+    {
+        for(std::vector<int>::iterator p = m_heap.begin(); p != m_heap.end(); ++p) {
+            m_positions[*p] = -1;
+        }
+        m_heap.clear();
+        if(m_positions.size() < n) {
+            m_positions.resize(n, -1);
+            m_keys.resize(n);
+        }
+    }
+
+    bool   empty() const          { return m_heap.empty(); }
+    size_t size() const           { return m_heap.size(); }
+    bool   contains(int id) const { return m_positions[id] != -1; }
+    int    top() const            { return m_heap[0]; }
+    float  get_key(int id) const  { return m_keys[id]; }
+
+    // insert id, or lower its key if already queued with a larger one
+    void push(int id, float key)
+    {
+        int pos = m_positions[id];
+        if(pos == -1) {
+            pos = m_heap.size();
+            m_heap.push_back(id);
+            m_positions[id] = pos;
+        } else if(key >= m_keys[id]) {
+            return;
+        }
+        m_keys[id] = key;
+        sift_up(pos);
+    }
+    int pop()
+    {
+        int id = m_heap[0];
+        int last_id = m_heap.back();
+        m_heap.pop_back();
+        m_positions[id] = -1;
+        if(m_heap.size()) {
+            m_heap[0] = last_id;
+            m_positions[last_id] = 0;
+            sift_down(0);
+        }
+        return id;
+    }
+
+private:
+    void sift_up(int pos)
+    {
+        int id = m_heap[pos];
+        while(pos > 0) {
+            int parent_pos = (pos - 1) >> 1;
+            int parent_id  = m_heap[parent_pos];
+            if(m_keys[parent_id] <= m_keys[id]) {
+                break;
+            }
+            m_heap[pos] = parent_id;
+            m_positions[parent_id] = pos;
+            pos = parent_pos;
+        }
+        m_heap[pos] = id;
+        m_positions[id] = pos;
+    }
+    void sift_down(int pos)
+    {
+        int id = m_heap[pos];
+        int n  = m_heap.size();
+        for(;;) {
+            int child_pos = (pos << 1) + 1;
+            if(child_pos >= n) {
+                break;
+            }
+            if(child_pos + 1 < n && m_keys[m_heap[child_pos + 1]] < m_keys[m_heap[child_pos]]) {
+                child_pos++;
+            }
+            int child_id = m_heap[child_pos];
+            if(m_keys[id] <= m_keys[child_id]) {
+                break;
+            }
+            m_heap[pos] = child_id;
+            m_positions[child_id] = pos;
+            pos = child_pos;
+        }
+        m_heap[pos] = id;
+        m_positions[id] = pos;
+    }
+
+    std::vector<int>   m_heap;      // ids in heap order
+    std::vector<int>   m_positions; // id to heap slot (-1 if not queued)
+    std::vector<float> m_keys;      // by id
+};
+
+}
+
+#endif
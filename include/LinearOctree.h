@@ -0,0 +1,92 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_LINEAR_OCTREE_H_
+#define VT_LINEAR_OCTREE_H_
+
+#include <SpatialIndex.h>
+#include <FlatOctree.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+namespace vt {
+
+// drop-in alternative to Octree that keeps points sorted by 63-bit morton key in contiguous arrays
+// NOTE: insert/remove/move only mark the tree dirty; the node table is rebuilt by rebalance() or lazily by the next query
+// NOTE: concurrent const queries are safe; writers must not race with readers
+class LinearOctree : public SpatialIndex
+{
+public:
+    LinearOctree(glm::vec3 origin,
+                 glm::vec3 dim);
+    virtual ~LinearOctree();
+    void clear();
+
+    glm::vec3 get_origin() const       { return m_origin; }
+    glm::vec3 get_dim() const          { return m_dim; }
+    size_t    get_object_count() const { return m_slots.size(); } // not m_ids, which a lazy build swaps
+    size_t    get_node_count() const   { build_if_dirty(); return m_node_table.size(); }
+
+    bool insert(long id, glm::vec3 pos);
+    bool remove(long id);
+    int find(glm::vec3          target,
+             int                k,
+             std::vector<long>* nearest_k_vec,
+             float              radius = -1) const;
+    int find_batch(const glm::vec3* targets,
+                   size_t           n,
+                   int              k,
+                   float            radius,
+                   long*            nearest_k_ids,            // out: n * k capacity
+                   int*             nearest_k_offsets) const; // out: n + 1 csr offsets
+    int find_within_radius(glm::vec3 target,
+                           float     radius,
+                           long*     ids,                           // out: unsorted
+                           int       capacity,
+                           float*    dists_squared = NULL) const;   // out: optional
+    bool exists(long id);
+    bool move(long id, glm::vec3 pos);
+    bool rebalance();
+
+    void dump() const;
+
+private:
+    void build_if_dirty() const;
+    void build() const;
+    void build_hier(int node_index, int begin, int end, int depth) const;
+    uint64_t get_morton_key(glm::vec3 pos) const;
+
+    glm::vec3 m_origin;
+    glm::vec3 m_dim;
+
+    // sorted by morton key after build
+    mutable std::vector<uint64_t>           m_keys;
+    mutable std::vector<long>               m_ids;
+    mutable std::vector<glm::vec3>          m_positions;
+    mutable std::unordered_map<long, int>   m_slots;
+    mutable std::vector<flat_octree_node_t> m_node_table;
+    mutable std::atomic<bool>               m_is_dirty;
+    mutable std::mutex                      m_build_mutex; // serializes lazy builds from const queries
+};
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef VT_OBJECT_POOL_H_
+#define VT_OBJECT_POOL_H_
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+namespace vt {
+
+// fixed-size slot arena carved from chunked slabs
+// NOTE: slots stay constructed once handed out; recycled slots keep their previous state and must be reinitialized by the caller
+template<class T, size_t SlabSize = 256>
+class ObjectPool
+{
+public:
+    ObjectPool()
+        : m_used_count(0),
+          m_constructed_count(0)
+    {
+    }
+    ~ObjectPool()
+    {
+        for(size_t i = 0; i < m_constructed_count; i++) {
+            at(i)->~T();
+        }
+        for(typename std::vector<T*>::iterator p = m_slabs.begin(); p != m_slabs.end(); ++p) {
+            ::operator delete(*p);
+        }
+    }
+
+    T* alloc()
+    {
+        if(m_free_list.size()) {
+            T* object = m_free_list.back();
+            m_free_list.pop_back();
+            return object;
+        }
+        if(m_used_count == m_constructed_count) {
+            if(m_constructed_count == m_slabs.size() * SlabSize) {
+                m_slabs.push_back(static_cast<T*>(::operator new(sizeof(T) * SlabSize)));
+            }
+            ::new(static_cast<void*>(at(m_constructed_count))) T();
+            m_constructed_count++;
+        }
+        return at(m_used_count++);
+    }
+    void free(T* object)
+    {
+        m_free_list.push_back(object);
+    }
+    void reset() // O(1); recycles all slots at once
+    {
+        m_used_count = 0;
+        m_free_list.clear();
+    }
+
+    size_t get_live_count() const { return m_used_count - m_free_list.size(); }
+    size_t get_slab_count() const { return m_slabs.size(); }
+
+private:
+    T* at(size_t index) const
+    {
+        return m_slabs[index / SlabSize] + index % SlabSize;
+    }
+
+    std::vector<T*> m_slabs;
+    std::vector<T*> m_free_list;
+    size_t          m_used_count;        // bump index into slabs
+    size_t          m_constructed_count; // slots holding live objects (>= m_used_count)
+};
+
+}
+
+#endif
@@ -19,24 +19,23 @@
 #define VT_OCTREE_H_
 
 #include <glm/glm.hpp>
+#include <SpatialIndex.h>
+#include <AlignedAllocator.h>
+#include <ObjectPool.h>
 #include <Util.h>
 #include <queue>
 #include <map>
 #include <set>
+#include <unordered_map>
 
 namespace vt {
 
-typedef std::pair<long, float> id_dist_t;
+#define OCTREE_LEAF_LANE_COUNT 8  // leaf coordinates are padded to whole simd blocks
+#define OCTREE_LEAF_ALIGNMENT  32
 
-struct id_dist_less_than_t
-{
-    bool operator()(const id_dist_t& a, const id_dist_t& b) const
-    {
-        return a.second < b.second;
-    }
-};
+typedef std::vector<float, aligned_allocator<float, OCTREE_LEAF_ALIGNMENT>> aligned_floats_t;
 
-class Octree
+class Octree : public SpatialIndex
 {
 public:
     Octree(glm::vec3 origin,
@@ -59,31 +58,109 @@ public:
     int       get_child_count() const       { return m_child_count; }
     bool      is_leaf() const               { return !m_child_count; }
     bool      is_root() const               { return !m_parent; }
-    size_t    get_leaf_object_count() const { return m_leaf_objects.size(); }
+    size_t    get_leaf_object_count() const { return m_leaf_ids.size(); }
+    float     get_mass() const              { return m_mass; }
+    glm::vec3 get_mass_center() const       { return m_mass > 0 ? m_mass_moment * (1.0f / m_mass) : m_center; }
 
     bool insert(long id, glm::vec3 pos);
+    bool insert(long id, glm::vec3 pos, float mass);
     bool remove(long id);
     int find(glm::vec3          target,
              int                k,
              std::vector<long>* nearest_k_vec,
              float              radius = -1) const;
+    int find_batch(const glm::vec3* targets,
+                   size_t           n,
+                   int              k,
+                   float            radius,
+                   long*            nearest_k_ids,            // out: n * k capacity
+                   int*             nearest_k_offsets) const; // out: n + 1 csr offsets
+    int find_within_radius(glm::vec3 target,
+                           float     radius,
+                           long*     ids,                           // out: unsorted
+                           int       capacity,
+                           float*    dists_squared = NULL) const;   // out: optional
     bool exists(long id);
+
+    // approximate knn; each result is within (1 + eps) of the true ith nearest unless the leaf budget runs out first
+    int find_approx(glm::vec3          target,
+                    int                k,
+                    std::vector<long>* nearest_k_vec,
+                    float              eps,
+                    int                max_leaf_visits = -1, // -1 for unlimited
+                    float              radius          = -1) const;
+    int find_batch_approx(const glm::vec3* targets,
+                          size_t           n,
+                          int              k,
+                          float            radius,
+                          float            eps,
+                          int              max_leaf_visits,          // -1 for unlimited
+                          long*            nearest_k_ids,            // out: n * k capacity
+                          int*             nearest_k_offsets) const; // out: n + 1 csr offsets
     bool move(long id, glm::vec3 pos);
     bool rebalance();
 
+    // loose octree; non-root node bounds are inflated by looseness so small moves stay in-node
+    // NOTE: call rebalance() after reducing looseness
+    void set_looseness(float looseness);
+    float get_looseness() const { return m_root->m_looseness; }
+
+    // barnes-hut gravity; per-node mass aggregates are only maintained while mass tracking is enabled
+    void set_track_mass(bool track_mass);
+    bool get_track_mass() const { return m_root->m_track_mass; }
+    float get_object_mass(long id) const;
+    glm::vec3 accumulate_force(glm::vec3 pos, float theta, float softening = 0) const; // sum of mass * dir / dist^2
+
     std::string get_name() const;
     void dump() const;
 
 private:
-    void find_hier(glm::vec3                                                                    target,
-                   int                                                                          k,
-                   std::priority_queue<id_dist_t, std::vector<id_dist_t>, id_dist_less_than_t>* nearest_k_pq,
-                   bool                                                                         is_direct_lineage,
-                   float                                                                        radius) const;
+    Octree(); // pool slot; see init()
+    void init(glm::vec3 origin,
+              glm::vec3 dim,
+              int       index,
+              int       depth,
+              Octree*   parent,
+              Octree*   root);
+    void free_hier();
+    int find_into(glm::vec3               target,
+                  int                     k,
+                  float                   radius,
+                  std::vector<id_dist_t>* nearest_k_heap, // scratch
+                  long*                   nearest_k_ids,  // out
+                  float                   eps             = 0,
+                  int                     max_leaf_visits = -1) const;
+    void find_hier(glm::vec3               target,
+                   int                     k,
+                   std::vector<id_dist_t>* nearest_k_heap,
+                   bool                    is_direct_lineage,
+                   float                   radius,
+                   float                   approx_factor_squared = 1,     // (1 + eps)^2
+                   int*                    leaf_budget           = NULL) const;
+    void find_within_radius_hier(glm::vec3 target,
+                                 float     radius_squared,
+                                 long*     ids,
+                                 int       capacity,
+                                 float*    dists_squared,
+                                 int*      count) const;
+    int find_leaf_slot(long id) const;
+    glm::vec3 get_leaf_object_pos(int slot) const;
+    void set_leaf_object_pos(int slot, glm::vec3 pos);
+    void add_leaf_object(long id, glm::vec3 pos);
+    void remove_leaf_object(int slot);
+    void clear_leaf_objects();
+    void forget_leaf_objects(); // drop root lookups for own leaf ids
+    Octree* insert_hier(long id, glm::vec3 pos); // returns including leaf node
+    Octree* relocate(long id, glm::vec3 pos);    // returns including leaf node
+    void prune_empty_lineage();
+    void update_mass_hier(glm::vec3 pos, float mass, const Octree* stop_node = NULL);
+    void rebuild_mass_hier();
     Octree* alloc_octant(glm::vec3 pos);
     Octree* first_including_parent_node(glm::vec3 pos);
     int get_octant_index(glm::vec3 pos) const;
     bool within_bbox(glm::vec3 pos) const;
+    bool within_loose_bbox(glm::vec3 pos) const;
+    float get_slack() const;
 
     glm::vec3                 m_origin;
     glm::vec3                 m_dim;
@@ -94,7 +171,28 @@ private:
     Octree*                   m_parent;
     Octree*                   m_root;
     int                       m_child_count;
-    std::map<long, glm::vec3> m_leaf_objects;
+
+    // leaf contents (structure of arrays)
+    std::vector<long>         m_leaf_ids;
+    aligned_floats_t          m_leaf_xs;
+    aligned_floats_t          m_leaf_ys;
+    aligned_floats_t          m_leaf_zs;
+
+    // loose octree
+    float                             m_looseness;     // root only
+    std::unordered_map<long, Octree*> m_object_leaves; // root only; id to including leaf node
+
+    // barnes-hut aggregates
+    bool                      m_track_mass;    // root only
+    float                     m_mass;
+    glm::vec3                 m_mass_moment;   // sum of mass * pos
+    std::map<long, float>     m_object_masses; // root only; non-unit masses
+
+    // node arena
+    ObjectPool<Octree>*       m_node_pool;     // root only; owns all non-root nodes
+
+    friend class ObjectPool<Octree>;
+    friend class OctreeSnapshot;
 };
 
 }
@@ -0,0 +1,78 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_OCTREE_SNAPSHOT_H_
+#define VT_OCTREE_SNAPSHOT_H_
+
+#include <SpatialIndex.h>
+#include <FlatOctree.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vt {
+
+class Octree;
+
+// read-only copy of an Octree that any number of threads may query while the live tree is being updated
+// NOTE: double-buffer by alternating two snapshots; build() reuses storage so steady-state rebuilds don't allocate
+class OctreeSnapshot
+{
+public:
+    OctreeSnapshot();
+    virtual ~OctreeSnapshot();
+    void clear();
+    void build(const Octree* octree); // must not race with writers of octree
+
+    glm::vec3 get_origin() const       { return m_origin; }
+    glm::vec3 get_dim() const          { return m_dim; }
+    size_t    get_object_count() const { return m_ids.size(); }
+    size_t    get_node_count() const   { return m_node_table.size(); }
+    int       get_generation() const   { return m_generation; } // bumped by each build()
+
+    int find(glm::vec3          target,
+             int                k,
+             std::vector<long>* nearest_k_vec,
+             float              radius = -1) const;
+    int find_batch(const glm::vec3* targets,
+                   size_t           n,
+                   int              k,
+                   float            radius,
+                   long*            nearest_k_ids,            // out: n * k capacity
+                   int*             nearest_k_offsets) const; // out: n + 1 csr offsets
+    int find_within_radius(glm::vec3 target,
+                           float     radius,
+                           long*     ids,                           // out: unsorted
+                           int       capacity,
+                           float*    dists_squared = NULL) const;   // out: optional
+
+    void dump() const;
+
+private:
+    glm::vec3 m_origin;
+    glm::vec3 m_dim;
+    int       m_generation;
+
+    // leaf points grouped by node in breadth-first order
+    std::vector<long>               m_ids;
+    std::vector<glm::vec3>          m_positions;
+    std::vector<flat_octree_node_t> m_node_table;
+    std::vector<const Octree*>      m_build_queue; // scratch
+};
+
+}
+
+#endif
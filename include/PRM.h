@@ -18,26 +18,41 @@
 #ifndef VT_PRM_H_
 #define VT_PRM_H_
 
-#include <Octree.h>
+#include <SpatialIndex.h>
+#include <BBoxOctree.h>
+#include <IndexedHeap.h>
 #include <Mesh.h>
 #include <tuple>
+#include <utility>
+#include <vector>
+#include <string>
+#include <stdint.h>
 #include <glm/glm.hpp>
 
 namespace vt {
 
+// a* scratch; reused across queries, entries are valid only where stamped with current search
+struct prm_search_scratch_t
+{
+    std::vector<float> m_g_costs;
+    std::vector<int>   m_predecessors;
+    std::vector<int>   m_search_stamps;
+    std::vector<int>   m_closed_stamps;
+    int                m_search_stamp;
+    IndexedHeap        m_open_set;
+
+    prm_search_scratch_t() : m_search_stamp(0) {}
+};
+
 class PRM_Waypoint
 {
 public:
     PRM_Waypoint(glm::vec3 origin);
     const glm::vec3 &get_origin() const { return m_origin; }
     void set_origin(glm::vec3 origin)   { m_origin = origin; }
-    void connect(int neighbor_index, float dist);
-    void disconnect(int neighbor_index);
-    const std::map<int, float>& get_connected() const { return m_neighbor_indices; }
 
 private:
-    glm::vec3            m_origin;
-    std::map<int, float> m_neighbor_indices;
+    glm::vec3 m_origin;
 };
 
 class PRM
@@ -46,25 +61,80 @@ public:
     typedef enum { EXPORT_EDGE_P1,
                    EXPORT_EDGE_P2,
                    EXPORT_EDGE_COST } export_edge_attr_t;
+    typedef enum { EDGE_STATE_UNKNOWN,
+                   EDGE_STATE_VALID,
+                   EDGE_STATE_INVALID } edge_state_t;
 
-    PRM(Octree* octree);
+    PRM(SpatialIndex* octree);
     ~PRM();
     void randomize_waypoints(size_t n);
     void connect_waypoints(int k, float radius);
+    void add_waypoints(size_t n, int k, float radius);
     int find_nearest_waypoint(glm::vec3 pos) const;
     bool find_shortest_path(glm::vec3 start_pos, glm::vec3 finish_pos, std::vector<int>* path);
+    int find_shortest_paths(const std::vector<std::pair<glm::vec3, glm::vec3>>& queries,
+                            std::vector<std::vector<int>>*                      paths) const; // safe alongside other batch queries; lazy mode writes edge states
     void prune_edges();
+    int validate_edges();
+    void reset_edge_states(); // call after moving obstacles without update_obstacle
     bool export_waypoints(std::vector<glm::vec3>* waypoint_values) const;
     bool export_edges(std::vector<std::tuple<int, int, float>>* edges) const;
-    void add_obstacle(Mesh* obstacle);
+    long add_obstacle(Mesh* obstacle);
+    bool remove_obstacle(long id);
+    bool update_obstacle(long id);
     PRM_Waypoint* at(int index) const;
+    const BBoxOctree* get_obstacles() const { return &m_obstacles; }
     void clear();
 
+    // binary roadmap persistence; see prm_file_header_t in PRM.cpp for the layout
+    uint64_t get_obstacle_fingerprint() const;
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+
+    // lazy mode defers collision checks to find_shortest_path, which validates only edges on the tentative best path
+    // NOTE: otherwise every roadmap or obstacle change validates the edges it affects right away
+    bool get_lazy() const    { return m_lazy; }
+    void set_lazy(bool lazy) { m_lazy = lazy; }
+
+    // roadmap adjacency in compressed sparse row layout; neighbors of i are [offsets[i], offsets[i + 1])
+    const std::vector<int>&   get_neighbor_offsets() const { return m_neighbor_offsets; }
+    const std::vector<int>&   get_neighbor_indices() const { return m_neighbor_indices; }
+    const std::vector<float>& get_neighbor_costs() const   { return m_neighbor_costs; }
+    const std::vector<char>&  get_neighbor_states() const  { return m_neighbor_states; } // edge_state_t
+
 private:
-    Octree*                                  m_octree;
+    void sample_waypoints(size_t n);
+    void collect_edges(int first_index, size_t n, int k, float radius, std::vector<std::tuple<int, int, float>>* edges) const;
+    void gather_edges(std::vector<std::tuple<int, int, float>>* edges, std::vector<char>* edge_states) const;
+    void build_adjacency(const std::vector<std::tuple<int, int, float>>& edges, const std::vector<char>* edge_states = NULL);
+    void reset_edge_states(glm::vec3 min, glm::vec3 max, bool reset_valid, bool reset_invalid);
+    bool load_mapped(const void* data, size_t size);
+    bool find_path_indices(int                   start_index,
+                           int                   finish_index,
+                           std::vector<char>*    edge_states,
+                           prm_search_scratch_t* scratch,
+                           std::vector<int>*     path) const;
+    bool search_path(int                      start_index,
+                     int                      finish_index,
+                     const std::vector<char>& edge_states,
+                     prm_search_scratch_t*    scratch) const;
+    bool validate_path(int finish_index, std::vector<char>* edge_states, const prm_search_scratch_t* scratch) const;
+    void set_edge_state(int p1_index, int p2_index, edge_state_t edge_state, std::vector<char>* edge_states) const;
+
+    SpatialIndex*                            m_octree;
     std::vector<PRM_Waypoint*>               m_waypoints;
-    std::vector<std::tuple<int, int, float>> m_edges;
-    std::vector<Mesh*>                       m_obstacles;
+    BBoxOctree                               m_obstacles;
+
+    // csr adjacency; each undirected edge is stored in both directions
+    std::vector<int>                         m_neighbor_offsets; // waypoint count + 1
+    std::vector<int>                         m_neighbor_indices;
+    std::vector<float>                       m_neighbor_costs;
+    mutable std::vector<char>                m_neighbor_states;  // edge_state_t, kept in sync for both directions; batch queries write it too
+    float                                    m_max_edge_cost;
+    bool                                     m_lazy;
+    long                                     m_next_obstacle_id;
+
+    prm_search_scratch_t                     m_search_scratch; // single queries only
 };
 
 }
@@ -0,0 +1,61 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_PATH_SMOOTHER_H_
+#define VT_PATH_SMOOTHER_H_
+
+#include <BBoxOctree.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vt {
+
+// post-processes planner paths against the planner's obstacles
+// NOTE: keyframe control points follow KeyframeMgr::update_control_points, so call it with the same scale afterward
+class PathSmoother
+{
+public:
+    PathSmoother(const BBoxOctree* obstacles);
+
+    // randomized shortcutting; drops waypoints bypassed by collision-free chords and returns how many were dropped
+    int shortcut_path(std::vector<glm::vec3>* path, int iterations) const;
+
+    // inserts the fewest origin keyframes whose spline stays within tolerance of path and clear of obstacles
+    // returns the number of keyframes inserted
+    int insert_keyframes(const std::vector<glm::vec3>& path,
+                         long                          object_id,
+                         int                           start_frame,
+                         float                         frames_per_unit_length,
+                         float                         tolerance,
+                         float                         control_point_scale) const;
+
+private:
+    bool is_spline_valid(const std::vector<glm::vec3>& path,
+                         const std::vector<int>&       key_indices,
+                         const std::vector<bool>&      key_smooth,
+                         float                         tolerance,
+                         float                         control_point_scale,
+                         int                           first_segment,
+                         int                           last_segment,
+                         std::vector<int>*             bad_segments) const;
+
+    const BBoxOctree* m_obstacles;
+};
+
+}
+
+#endif
@@ -0,0 +1,79 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_RRT_H_
+#define VT_RRT_H_
+
+#include <PRM.h>
+#include <Octree.h>
+#include <BBoxOctree.h>
+#include <Mesh.h>
+#include <tuple>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace vt {
+
+// single-query planner growing one tree from each end until they meet; no roadmap is built
+// NOTE: waypoints of both trees share one index space, so paths are consumed like PRM paths
+class RRT
+{
+public:
+    typedef enum { EXTEND_REACHED,
+                   EXTEND_ADVANCED,
+                   EXTEND_TRAPPED } extend_result_t;
+
+    RRT(glm::vec3 origin, glm::vec3 dim);
+    ~RRT();
+    bool find_shortest_path(glm::vec3 start_pos, glm::vec3 finish_pos, std::vector<int>* path);
+    bool export_waypoints(std::vector<glm::vec3>* waypoint_values) const;
+    bool export_edges(std::vector<std::tuple<int, int, float>>* edges) const;
+    long add_obstacle(Mesh* obstacle);
+    bool remove_obstacle(long id);
+    PRM_Waypoint* at(int index) const;
+    size_t get_waypoint_count() const { return m_waypoints.size(); }
+    const BBoxOctree* get_obstacles() const { return &m_obstacles; }
+    void clear();
+
+    float get_step_size() const                   { return m_step_size; }
+    void  set_step_size(float step_size)          { m_step_size = step_size; }
+    int   get_max_iterations() const              { return m_max_iterations; }
+    void  set_max_iterations(int max_iterations)  { m_max_iterations = max_iterations; }
+
+private:
+    Octree* get_tree(int tree_index) { return tree_index ? &m_finish_tree : &m_start_tree; }
+    void clear_trees();
+    int add_waypoint(int tree_index, glm::vec3 origin, int parent_index);
+    extend_result_t extend(int tree_index, glm::vec3 target, int* new_index);
+    extend_result_t connect(int tree_index, glm::vec3 target, int* new_index);
+    void build_path(int start_tree_meet_index, int finish_tree_meet_index, std::vector<int>* path) const;
+
+    glm::vec3                  m_origin;
+    glm::vec3                  m_dim;
+    Octree                     m_start_tree;    // nearest-node lookup per tree
+    Octree                     m_finish_tree;
+    std::vector<PRM_Waypoint*> m_waypoints;
+    std::vector<int>           m_parents;       // -1 at tree roots
+    BBoxOctree                 m_obstacles;
+    long                       m_next_obstacle_id;
+    float                      m_step_size;
+    int                        m_max_iterations;
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_RANDOM_H_
+#define VT_RANDOM_H_
+
+#include <glm/glm.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace vt {
+
+// counter-based generator; value i of a stream is a pure function of (seed, stream, i), so streams never overlap
+// and bulk fills give the same samples whatever the thread count
+// NOTE: instance() keys its stream on the WorkerPool thread index, so pool worker i always draws from stream i;
+//       other threads share stream 0 with the caller and should construct their own Random with an explicit stream
+// NOTE: pool chunks are claimed dynamically, so draws inside a WorkerPool task are only reproducible when indexed by
+//       counter (see fill_uniform_vec3), not when drawn from instance()
+class Random
+{
+public:
+    Random(uint64_t seed = 0, uint64_t stream = 0);
+    void seed(uint64_t seed, uint64_t stream = 0);
+
+    static Random* instance(); // thread-local
+    static void set_seed(uint64_t seed); // reseeds every thread's stream on its next instance() call
+
+    uint64_t  get_stream() const  { return m_stream; }
+    uint64_t  get_counter() const { return m_counter; }
+    void      skip(uint64_t count) { m_counter += count; m_buffer_index = 4; }
+
+    uint32_t  next_uint();
+    int       next_int(int n);             // [0, n)
+    float     next_float();                // [0, 1)
+    glm::vec3 next_vec3();                 // [0, 1) per component
+    glm::vec3 next_vec3(glm::vec3 min, glm::vec3 max);
+
+    // one counter block per sample, generated a simd batch of blocks at a time and split across the worker pool;
+    // advances the counter by n
+    void fill_uniform_vec3(glm::vec3* values, size_t n, glm::vec3 min, glm::vec3 max);
+
+private:
+    uint64_t m_seed;
+    uint64_t m_stream;
+    uint64_t m_counter;
+    uint32_t m_buffer[4];    // unused words of the last block
+    int      m_buffer_index;
+    int      m_seed_generation;
+};
+
+}
+
+#endif
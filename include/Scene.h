@@ -32,6 +32,7 @@ class Material;
 class Mesh;
 class Texture;
 class Octree;
+class SpatialIndex;
 
 struct DebugObjectContext
 {
@@ -124,11 +125,11 @@ public:
         return m_camera;
     }
 
-    void set_octree(Octree* octree)
+    void set_octree(SpatialIndex* octree)
     {
         m_octree = octree;
     }
-    Octree* get_octree() const
+    SpatialIndex* get_octree() const
     {
         return m_octree;
     }
@@ -244,17 +245,17 @@ public:
                             float     luminosity);
 
 private:
-    Camera*     m_camera;
-    Octree*     m_octree;
-    Mesh*       m_skybox;
-    Mesh*       m_overlay;
-    lights_t    m_lights;
-    meshes_t    m_meshes;
-    materials_t m_materials;
-    textures_t  m_textures;
-    Material*   m_normal_material;
-    Material*   m_wireframe_material;
-    Material*   m_ssao_material;
+    Camera*       m_camera;
+    SpatialIndex* m_octree;
+    Mesh*         m_skybox;
+    Mesh*         m_overlay;
+    lights_t      m_lights;
+    meshes_t      m_meshes;
+    materials_t   m_materials;
+    textures_t    m_textures;
+    Material*     m_normal_material;
+    Material*     m_wireframe_material;
+    Material*     m_ssao_material;
 
     GLfloat* m_bloom_kernel;
     GLfloat  m_glow_cutoff_threshold;
@@ -0,0 +1,87 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_SPATIAL_INDEX_H_
+#define VT_SPATIAL_INDEX_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+
+namespace vt {
+
+typedef std::pair<long, float> id_dist_t;
+
+struct id_dist_less_than_t
+{
+    bool operator()(const id_dist_t& a, const id_dist_t& b) const
+    {
+        return a.second < b.second;
+    }
+};
+
+// compact k-sized result slots into csr layout; slot sizes are parked in offsets[i + 1]
+inline int compact_batch_results(size_t n, int k, long* nearest_k_ids, int* nearest_k_offsets)
+{
+    nearest_k_offsets[0] = 0;
+    for(size_t i = 0; i < n; i++) {
+        int result_size = nearest_k_offsets[i + 1];
+        if(nearest_k_offsets[i] != static_cast<int>(i * k)) {
+            std::copy(&nearest_k_ids[i * k], &nearest_k_ids[i * k] + result_size, &nearest_k_ids[nearest_k_offsets[i]]);
+        }
+        nearest_k_offsets[i + 1] = nearest_k_offsets[i] + result_size;
+    }
+    return nearest_k_offsets[n];
+}
+
+// point index interface shared by Octree, LinearOctree and HashGrid
+// NOTE: find() inserts up to k ids, nearest first, at the front of nearest_k_vec and returns its new size
+// NOTE: const queries may run concurrently with each other, but not with writers
+class SpatialIndex
+{
+public:
+    virtual ~SpatialIndex() {}
+    virtual void      clear() = 0;
+    virtual glm::vec3 get_origin() const = 0;
+    virtual glm::vec3 get_dim() const = 0;
+    virtual bool      insert(long id, glm::vec3 pos) = 0;
+    virtual bool      remove(long id) = 0;
+    virtual int       find(glm::vec3          target,
+                           int                k,
+                           std::vector<long>* nearest_k_vec,
+                           float              radius = -1) const = 0;
+    virtual int       find_batch(const glm::vec3* targets,
+                                 size_t           n,
+                                 int              k,
+                                 float            radius,
+                                 long*            nearest_k_ids,                // out: n * k capacity
+                                 int*             nearest_k_offsets) const = 0; // out: n + 1 csr offsets
+    virtual int       find_within_radius(glm::vec3 target,
+                                         float     radius,
+                                         long*     ids,                         // out: unsorted
+                                         int       capacity,
+                                         float*    dists_squared = NULL) const = 0; // out: optional
+    virtual bool      exists(long id) = 0;
+    virtual bool      move(long id, glm::vec3 pos) = 0;
+    virtual bool      rebalance() = 0;
+    virtual void      dump() const = 0;
+};
+
+}
+
+#endif
@@ -111,6 +111,14 @@ public:
                       int              iters,
                       float            accept_end_effector_distance,
                       float            accept_avg_angle_distance);
+    bool solve_ik_dls(TransformObject* root,
+                      glm::vec3        local_end_effector_tip,
+                      glm::vec3        target,
+                      glm::vec3*       end_effector_dir,
+                      int              iters,
+                      float            accept_end_effector_distance,
+                      float            accept_avg_angle_distance,
+                      float            damping);
     void update_boid(glm::vec3 target,
                      float     forward_speed,
                      float     angle_delta,
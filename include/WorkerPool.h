@@ -0,0 +1,69 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VT_WORKER_POOL_H_
+#define VT_WORKER_POOL_H_
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+namespace vt {
+
+// persistent threads that split an index range [0, n) into chunks
+// NOTE: the calling thread participates as thread 0; run() is not reentrant from within a task
+class WorkerPool
+{
+public:
+    typedef std::function<void(int thread_index, size_t begin, size_t end)> task_t;
+
+    static WorkerPool* instance()
+    {
+        static WorkerPool worker_pool;
+        return &worker_pool;
+    }
+
+    int get_thread_count() const { return m_threads.size() + 1; }
+    static int get_thread_index(); // calling thread's index in the pool; 0 outside pool workers
+    void run(size_t n, task_t task, size_t grain_size = 0);
+
+private:
+    WorkerPool();
+    ~WorkerPool();
+    void worker_loop(int thread_index);
+    void run_chunks(int thread_index);
+
+    std::vector<std::thread> m_threads;
+    std::mutex               m_run_mutex;
+    std::mutex               m_mutex;
+    std::condition_variable  m_start_cv;
+    std::condition_variable  m_done_cv;
+    task_t                   m_task;
+    size_t                   m_n;
+    size_t                   m_grain_size;
+    std::atomic<size_t>      m_next_index;
+    int                      m_generation;
+    int                      m_busy_count;
+    bool                     m_shutdown;
+};
+
+}
+
+#endif
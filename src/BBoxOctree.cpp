@@ -0,0 +1,512 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <BBoxOctree.h>
+#include <Mesh.h>
+#include <PrimitiveFactory.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <memory.h>
+
+#define DEPTH_LIMIT 4
+
+namespace vt {
+
+BBoxOctree::BBoxOctree(glm::vec3   origin,
+                       glm::vec3   dim,
+                       int         index,
+                       int         depth,
+                       BBoxOctree* parent,
+                       BBoxOctree* root)
+    : m_origin(origin),
+      m_dim(dim),
+      m_center(origin + dim * 0.5f),
+      m_index(index),
+      m_depth(depth),
+      m_parent(parent),
+      m_root(parent ? root : this),
+      m_child_count(0)
+{
+    memset(m_nodes, 0, sizeof(BBoxOctree*) * 8);
+}
+
+BBoxOctree::~BBoxOctree()
+{
+    clear();
+}
+
+void BBoxOctree::clear()
+{
+    m_node_objects.clear(); // purge node contents
+    if(is_root()) {
+        m_objects.clear();
+    }
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        delete m_nodes[i];
+        m_nodes[i] = NULL;
+        m_child_count--;
+    }
+}
+
+void BBoxOctree::prune_empty_nodes()
+{
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        m_nodes[i]->prune_empty_nodes();
+        if(!m_nodes[i]->is_leaf() || m_nodes[i]->get_node_object_count()) {
+            continue;
+        }
+        delete m_nodes[i];
+        m_nodes[i] = NULL;
+        m_child_count--;
+    }
+}
+
+bool BBoxOctree::insert(long id, Mesh* mesh)
+{
+    if(!mesh || m_root->m_objects.find(id) != m_root->m_objects.end()) { // object already added?
+        return false;
+    }
+    bbox_octree_object_t* object = &m_root->m_objects[id];
+    object->m_mesh = mesh;
+    object->m_node = NULL;
+    calc_world_min_max(mesh, object);
+    m_root->insert_hier(id, object);
+    return true;
+}
+
+bool BBoxOctree::remove(long id)
+{
+    std::map<long, bbox_octree_object_t>::iterator p = m_root->m_objects.find(id);
+    if(p == m_root->m_objects.end()) {
+        return false;
+    }
+    (*p).second.m_node->remove_from_node(id);
+    m_root->m_objects.erase(p); // remove core action
+    return true;
+}
+
+bool BBoxOctree::exists(long id) const
+{
+    return m_root->m_objects.find(id) != m_root->m_objects.end();
+}
+
+Mesh* BBoxOctree::get_mesh(long id) const
+{
+    std::map<long, bbox_octree_object_t>::const_iterator p = m_root->m_objects.find(id);
+    if(p == m_root->m_objects.end()) {
+        return NULL;
+    }
+    return (*p).second.m_mesh;
+}
+
+bool BBoxOctree::get_min_max(long id, glm::vec3* min, glm::vec3* max) const
+{
+    std::map<long, bbox_octree_object_t>::const_iterator p = m_root->m_objects.find(id);
+    if(p == m_root->m_objects.end()) {
+        return false;
+    }
+    if(min) {
+        *min = (*p).second.m_min;
+    }
+    if(max) {
+        *max = (*p).second.m_max;
+    }
+    return true;
+}
+
+int BBoxOctree::update()
+{
+    int update_count = 0;
+    for(std::map<long, bbox_octree_object_t>::iterator p = m_root->m_objects.begin(); p != m_root->m_objects.end(); ++p) {
+        if(update((*p).first)) {
+            update_count++;
+        }
+    }
+    if(update_count) {
+        m_root->prune_empty_nodes();
+    }
+    return update_count;
+}
+
+bool BBoxOctree::update(long id)
+{
+    std::map<long, bbox_octree_object_t>::iterator p = m_root->m_objects.find(id);
+    if(p == m_root->m_objects.end()) {
+        return false;
+    }
+    bbox_octree_object_t* object = &(*p).second;
+    if(!calc_world_min_max(object->m_mesh, object)) {
+        return false;
+    }
+
+    // skip relocation if still contained and not small enough to sink further
+    BBoxOctree* node = object->m_node;
+    if(node->within_bbox(object->m_min, object->m_max) &&
+            (node->m_depth >= DEPTH_LIMIT || node->get_octant_index(object->m_min, object->m_max) == -1))
+    {
+        return true;
+    }
+    node->remove_from_node(id);
+    m_root->insert_hier(id, object);
+    return true;
+}
+
+int BBoxOctree::find_overlaps(glm::vec3          min,
+                              glm::vec3          max,
+                              std::vector<long>* overlap_ids) const
+{
+    if(!overlap_ids) {
+        return 0;
+    }
+    m_root->find_overlaps_hier(min, max, overlap_ids);
+    return overlap_ids->size();
+}
+
+int BBoxOctree::find_overlap_pairs(std::vector<id_pair_t>* overlap_pairs) const
+{
+    if(!overlap_pairs) {
+        return 0;
+    }
+    std::vector<long> ancestor_ids;
+    m_root->find_overlap_pairs_hier(&ancestor_ids, overlap_pairs);
+    return overlap_pairs->size();
+}
+
+bool BBoxOctree::raycast(glm::vec3  ray_origin,
+                         glm::vec3  ray_dir,
+                         float      max_dist,
+                         long*      hit_id,
+                         float*     hit_dist,
+                         glm::vec3* hit_normal) const
+{
+    if(glm::length(ray_dir) < EPSILON) {
+        return false;
+    }
+    ray_dir = glm::normalize(ray_dir);
+    glm::vec3 inv_ray_dir = glm::vec3(1.0f / ray_dir.x, 1.0f / ray_dir.y, 1.0f / ray_dir.z);
+    long      _hit_id     = -1;
+    float     _hit_dist   = max_dist;
+    glm::vec3 _hit_normal = glm::vec3(0);
+    m_root->raycast_hier(ray_origin, ray_dir, inv_ray_dir, &_hit_id, &_hit_dist, &_hit_normal);
+    if(_hit_id == -1) {
+        return false;
+    }
+    if(hit_id) {
+        *hit_id = _hit_id;
+    }
+    if(hit_dist) {
+        *hit_dist = _hit_dist;
+    }
+    if(hit_normal) {
+        *hit_normal = _hit_normal;
+    }
+    return true;
+}
+
+bool BBoxOctree::segment_query(glm::vec3  p1,
+                               glm::vec3  p2,
+                               long*      hit_id,
+                               float*     hit_dist,
+                               glm::vec3* hit_normal) const
+{
+    return raycast(p1, p2 - p1, glm::distance(p1, p2), hit_id, hit_dist, hit_normal);
+}
+
+std::string BBoxOctree::get_name() const
+{
+    std::stringstream ss;
+    ss << (m_parent ? m_parent->get_name() + "." : "");
+    if(m_index == -1) {
+        ss << "<root>";
+    } else {
+        ss << m_index;
+    }
+    return ss.str();
+}
+
+void BBoxOctree::dump() const
+{
+    static size_t indent = 0;
+    std::string indent_str = std::string(indent, '\t');
+    std::cout << indent_str << this << std::endl;
+    std::cout << indent_str << "name: "    << get_name()              << std::endl;
+    std::cout << indent_str << "depth: "   << get_depth()             << std::endl;
+    std::cout << indent_str << "is_root: " << is_root()               << std::endl;
+    std::cout << indent_str << "is_leaf: " << is_leaf()               << std::endl;
+    std::cout << indent_str << "objects: " << get_node_object_count() << std::endl;
+    std::cout << std::endl;
+    indent++;
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        m_nodes[i]->dump();
+    }
+    indent--;
+}
+
+void BBoxOctree::insert_hier(long id, bbox_octree_object_t* object)
+{
+    // sink into octant that fully contains aabb
+    if(m_depth < DEPTH_LIMIT && within_bbox(object->m_min, object->m_max)) {
+        int octant_index = get_octant_index(object->m_min, object->m_max);
+        if(octant_index != -1) {
+            alloc_octant(octant_index)->insert_hier(id, object);
+            return;
+        }
+    }
+    m_node_objects.push_back(id); // insert core action
+    object->m_node = this;
+}
+
+void BBoxOctree::remove_from_node(long id)
+{
+    std::vector<long>::iterator p = std::find(m_node_objects.begin(), m_node_objects.end(), id);
+    if(p == m_node_objects.end()) {
+        return;
+    }
+    *p = m_node_objects.back();
+    m_node_objects.pop_back();
+}
+
+void BBoxOctree::find_overlaps_hier(glm::vec3          min,
+                                    glm::vec3          max,
+                                    std::vector<long>* overlap_ids) const
+{
+    for(std::vector<long>::const_iterator p = m_node_objects.begin(); p != m_node_objects.end(); ++p) {
+        const bbox_octree_object_t &object = (*m_root->m_objects.find(*p)).second;
+        if(is_aabb_overlap(object.m_min, object.m_max, min, max)) {
+            overlap_ids->push_back(*p);
+        }
+    }
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i] || !m_nodes[i]->is_overlap(min, max)) {
+            continue;
+        }
+        m_nodes[i]->find_overlaps_hier(min, max, overlap_ids);
+    }
+}
+
+// test each node's objects against each other and against objects held by ancestors
+void BBoxOctree::find_overlap_pairs_hier(std::vector<long>*      ancestor_ids,
+                                         std::vector<id_pair_t>* overlap_pairs) const
+{
+    std::vector<const bbox_octree_object_t*> node_objects;
+    for(std::vector<long>::const_iterator p = m_node_objects.begin(); p != m_node_objects.end(); ++p) {
+        node_objects.push_back(&(*m_root->m_objects.find(*p)).second);
+    }
+    for(size_t i = 0; i < m_node_objects.size(); i++) {
+        const bbox_octree_object_t* object = node_objects[i];
+        for(size_t j = i + 1; j < m_node_objects.size(); j++) {
+            const bbox_octree_object_t* other_object = node_objects[j];
+            if(is_aabb_overlap(object->m_min, object->m_max, other_object->m_min, other_object->m_max)) {
+                overlap_pairs->push_back(id_pair_t(std::min(m_node_objects[i], m_node_objects[j]),
+                                                   std::max(m_node_objects[i], m_node_objects[j])));
+            }
+        }
+        for(std::vector<long>::const_iterator q = ancestor_ids->begin(); q != ancestor_ids->end(); ++q) {
+            const bbox_octree_object_t &other_object = (*m_root->m_objects.find(*q)).second;
+            if(is_aabb_overlap(object->m_min, object->m_max, other_object.m_min, other_object.m_max)) {
+                overlap_pairs->push_back(id_pair_t(std::min(m_node_objects[i], *q),
+                                                   std::max(m_node_objects[i], *q)));
+            }
+        }
+    }
+    if(is_leaf()) {
+        return;
+    }
+    size_t ancestor_count = ancestor_ids->size();
+    ancestor_ids->insert(ancestor_ids->end(), m_node_objects.begin(), m_node_objects.end());
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        m_nodes[i]->find_overlap_pairs_hier(ancestor_ids, overlap_pairs);
+    }
+    ancestor_ids->resize(ancestor_count);
+}
+
+// NOTE: *hit_dist doubles as the current search horizon
+void BBoxOctree::raycast_hier(glm::vec3  ray_origin,
+                              glm::vec3  ray_dir,
+                              glm::vec3  inv_ray_dir,
+                              long*      hit_id,
+                              float*     hit_dist,
+                              glm::vec3* hit_normal) const
+{
+    // test objects held by this node (cheap aabb rejection first)
+    for(std::vector<long>::const_iterator p = m_node_objects.begin(); p != m_node_objects.end(); ++p) {
+        const bbox_octree_object_t &object = (*m_root->m_objects.find(*p)).second;
+        float entry_dist = ray_aabb_entry_dist(object.m_min, object.m_max, ray_origin, inv_ray_dir);
+        if(entry_dist == BIG_NUMBER || entry_dist > *hit_dist) {
+            continue;
+        }
+        glm::vec3 surface_point  = glm::vec3(0);
+        glm::vec3 surface_normal = glm::vec3(0);
+        float dist = ray_box_intersect(object.m_transform,
+                                       object.m_inverse_transform,
+                                       object.m_local_min,
+                                       object.m_local_max,
+                                       ray_origin,
+                                       ray_dir,
+                                       &surface_point,
+                                       &surface_normal);
+        if(dist == BIG_NUMBER) {
+            continue;
+        }
+        if(dist <= *hit_dist) {
+            *hit_id     = *p;
+            *hit_dist   = dist;
+            *hit_normal = surface_normal;
+        }
+    }
+    if(is_leaf()) {
+        return;
+    }
+
+    // visit octants front-to-back
+    std::pair<float, int> octant_dists[8];
+    int octant_count = 0;
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        float dist = ray_aabb_entry_dist(m_nodes[i]->m_origin, m_nodes[i]->m_origin + m_nodes[i]->m_dim, ray_origin, inv_ray_dir);
+        if(dist == BIG_NUMBER || dist > *hit_dist) {
+            continue;
+        }
+        octant_dists[octant_count++] = std::pair<float, int>(dist, i);
+    }
+    std::sort(octant_dists, octant_dists + octant_count);
+    for(int j = 0; j < octant_count; j++) {
+        if(octant_dists[j].first > *hit_dist) { // everything beyond is farther than nearest hit so far
+            break;
+        }
+        m_nodes[octant_dists[j].second]->raycast_hier(ray_origin, ray_dir, inv_ray_dir, hit_id, hit_dist, hit_normal);
+    }
+}
+
+BBoxOctree* BBoxOctree::alloc_octant(int octant_index)
+{
+    if(!m_nodes[octant_index]) {
+        glm::vec3 points[8];
+        glm::vec3 half_dim = m_dim * 0.5f;
+        vt::PrimitiveFactory::get_box_corners(points, &m_origin, &half_dim);
+        m_nodes[octant_index] = new BBoxOctree(points[octant_index], half_dim, octant_index, m_depth + 1, this, m_root);
+        m_child_count++;
+    }
+    return m_nodes[octant_index];
+}
+
+// returns -1 if aabb straddles any splitting plane
+int BBoxOctree::get_octant_index(glm::vec3 min, glm::vec3 max) const
+{
+    // same octant numbering as Octree::get_octant_index
+    bool min_upper_x = (min.x >= m_center.x), max_upper_x = (max.x >= m_center.x);
+    bool min_upper_y = (min.y >= m_center.y), max_upper_y = (max.y >= m_center.y);
+    bool min_upper_z = (min.z >= m_center.z), max_upper_z = (max.z >= m_center.z);
+    if(min_upper_x != max_upper_x || min_upper_y != max_upper_y || min_upper_z != max_upper_z) {
+        return -1;
+    }
+    static const int octant_index_table[8] = {0,  // -x -y -z
+                                              1,  // -x -y +z
+                                              4,  // -x +y -z
+                                              5,  // -x +y +z
+                                              3,  // +x -y -z
+                                              2,  // +x -y +z
+                                              7,  // +x +y -z
+                                              6}; // +x +y +z
+    return octant_index_table[(min_upper_x ? 4 : 0) | (min_upper_y ? 2 : 0) | (min_upper_z ? 1 : 0)];
+}
+
+bool BBoxOctree::within_bbox(glm::vec3 min, glm::vec3 max) const
+{
+    glm::vec3 node_min = m_origin;
+    glm::vec3 node_max = m_origin + m_dim;
+    return (node_min.x <= min.x && max.x <= node_max.x) &&
+           (node_min.y <= min.y && max.y <= node_max.y) &&
+           (node_min.z <= min.z && max.z <= node_max.z);
+}
+
+bool BBoxOctree::is_overlap(glm::vec3 min, glm::vec3 max) const
+{
+    return is_aabb_overlap(m_origin, m_origin + m_dim, min, max);
+}
+
+bool BBoxOctree::is_aabb_overlap(glm::vec3 min, glm::vec3 max, glm::vec3 other_min, glm::vec3 other_max)
+{
+    return (min.x <= other_max.x && other_min.x <= max.x) &&
+           (min.y <= other_max.y && other_min.y <= max.y) &&
+           (min.z <= other_max.z && other_min.z <= max.z);
+}
+
+// "slab method"; returns 0 if ray starts inside, BIG_NUMBER if ray misses
+float BBoxOctree::ray_aabb_entry_dist(glm::vec3 min, glm::vec3 max, glm::vec3 ray_origin, glm::vec3 inv_ray_dir)
+{
+    float t_near = 0;
+    float t_far  = BIG_NUMBER;
+    for(int i = 0; i < 3; i++) {
+        float t1 = (min[i] - ray_origin[i]) * inv_ray_dir[i];
+        float t2 = (max[i] - ray_origin[i]) * inv_ray_dir[i];
+        if(t1 != t1 || t2 != t2) { // parallel to slab with origin on slab boundary
+            continue;
+        }
+        t_near = std::max(t_near, std::min(t1, t2));
+        t_far  = std::min(t_far,  std::max(t1, t2));
+        if(t_near > t_far) {
+            return BIG_NUMBER;
+        }
+    }
+    return t_near;
+}
+
+// returns true if world aabb changed
+bool BBoxOctree::calc_world_min_max(Mesh* mesh, bbox_octree_object_t* object)
+{
+    glm::vec3 local_min, local_max;
+    mesh->get_min_max(&local_min, &local_max);
+    const glm::mat4 &transform = mesh->get_transform();
+    if(object->m_node && transform == object->m_transform && local_min == object->m_local_min && local_max == object->m_local_max) {
+        return false;
+    }
+    object->m_transform         = transform;
+    object->m_inverse_transform = glm::inverse(transform);
+    object->m_local_min         = local_min;
+    object->m_local_max         = local_max;
+    glm::vec3 points[8];
+    glm::vec3 dim = local_max - local_min;
+    vt::PrimitiveFactory::get_box_corners(points, &local_min, &dim);
+    object->m_min = glm::vec3(BIG_NUMBER);
+    object->m_max = glm::vec3(-BIG_NUMBER);
+    for(int i = 0; i < 8; i++) {
+        glm::vec3 abs_point = glm::vec3(transform * glm::vec4(points[i], 1));
+        object->m_min = glm::min(object->m_min, abs_point);
+        object->m_max = glm::max(object->m_max, abs_point);
+    }
+    return true;
+}
+
+}
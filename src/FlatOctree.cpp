@@ -0,0 +1,180 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <FlatOctree.h>
+#include <Util.h>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+
+namespace vt {
+
+static float box_distance_squared(glm::vec3 _min, glm::vec3 _max, glm::vec3 pos)
+{
+    float dx = std::max(std::max(_min.x - pos.x, 0.0f), pos.x - _max.x);
+    float dy = std::max(std::max(_min.y - pos.y, 0.0f), pos.y - _max.y);
+    float dz = std::max(std::max(_min.z - pos.z, 0.0f), pos.z - _max.z);
+    return dx * dx + dy * dy + dz * dz;
+}
+
+static void find_hier(const std::vector<flat_octree_node_t>& node_table,
+                      const std::vector<long>&               ids,
+                      const std::vector<glm::vec3>&          positions,
+                      int                                    node_index,
+                      glm::vec3                              target,
+                      int                                    k,
+                      std::vector<id_dist_t>*                nearest_k_heap,
+                      float                                  radius_squared)
+{
+    const flat_octree_node_t &node = node_table[node_index];
+
+    // own points
+    for(int i = node.m_begin; i < node.m_end; i++) {
+        glm::vec3 offset = positions[i] - target;
+        float dist_squared = glm::dot(offset, offset);
+        if(radius_squared > 0 && dist_squared > radius_squared) { // apply radius filter
+            continue;
+        }
+        if(static_cast<int>(nearest_k_heap->size()) < k) {
+            nearest_k_heap->push_back(id_dist_t(ids[i], dist_squared));
+            std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+            continue;
+        }
+        if(dist_squared >= nearest_k_heap->front().second) { // no better than current kth nearest
+            continue;
+        }
+        std::pop_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+        nearest_k_heap->back() = id_dist_t(ids[i], dist_squared);
+        std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+    }
+
+    // visit nearest children first so the kth nearest distance shrinks quickly
+    id_dist_t child_dists[8];
+    int child_count = 0;
+    for(int i = 0; i < node.m_child_count; i++) {
+        int child_index = node.m_first_child + i;
+        const flat_octree_node_t &child = node_table[child_index];
+        float dist_squared = box_distance_squared(child.m_min, child.m_max, target);
+        if(radius_squared > 0 && dist_squared > radius_squared) { // apply radius filter
+            continue;
+        }
+        child_dists[child_count++] = id_dist_t(child_index, dist_squared);
+    }
+    std::sort(child_dists, child_dists + child_count, id_dist_less_than_t());
+    for(int i = 0; i < child_count; i++) {
+        if(static_cast<int>(nearest_k_heap->size()) >= k && child_dists[i].second >= nearest_k_heap->front().second) {
+            break; // remaining children are all farther than current kth nearest
+        }
+        find_hier(node_table, ids, positions, child_dists[i].first, target, k, nearest_k_heap, radius_squared);
+    }
+}
+
+static void find_within_radius_hier(const std::vector<flat_octree_node_t>& node_table,
+                                    const std::vector<long>&               ids,
+                                    const std::vector<glm::vec3>&          positions,
+                                    int                                    node_index,
+                                    glm::vec3                              target,
+                                    float                                  radius_squared,
+                                    long*                                  result_ids,
+                                    int                                    capacity,
+                                    float*                                 dists_squared,
+                                    int*                                   count)
+{
+    const flat_octree_node_t &node = node_table[node_index];
+    if(box_distance_squared(node.m_min, node.m_max, target) > radius_squared) {
+        return;
+    }
+    for(int i = node.m_begin; i < node.m_end; i++) {
+        glm::vec3 offset = positions[i] - target;
+        float dist_squared = glm::dot(offset, offset);
+        if(dist_squared > radius_squared) {
+            continue;
+        }
+        if(*count < capacity) {
+            result_ids[*count] = ids[i];
+            if(dists_squared) {
+                dists_squared[*count] = dist_squared;
+            }
+        }
+        (*count)++;
+    }
+    for(int i = 0; i < node.m_child_count; i++) {
+        find_within_radius_hier(node_table, ids, positions, node.m_first_child + i, target, radius_squared, result_ids, capacity, dists_squared, count);
+    }
+}
+
+int flat_octree_find(const std::vector<flat_octree_node_t>& node_table,
+                     const std::vector<long>&               ids,
+                     const std::vector<glm::vec3>&          positions,
+                     glm::vec3                              target,
+                     int                                    k,
+                     float                                  radius,
+                     std::vector<id_dist_t>*                nearest_k_heap,
+                     long*                                  nearest_k_ids)
+{
+    if(k <= 0 || node_table.empty()) {
+        return 0;
+    }
+
+    // bounded max-heap keyed on squared distance; root is current kth nearest
+    nearest_k_heap->clear();
+    nearest_k_heap->reserve(k);
+    find_hier(node_table, ids, positions, 0, target, k, nearest_k_heap, radius > 0 ? radius * radius : -1);
+
+    // sort ascending
+    std::sort_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+    int result_size = nearest_k_heap->size();
+    for(int i = 0; i < result_size; i++) {
+        nearest_k_ids[i] = (*nearest_k_heap)[i].first;
+    }
+    return result_size;
+}
+
+// streams ids into caller-owned buffer without sorting; returns total match count (may exceed capacity)
+int flat_octree_find_within_radius(const std::vector<flat_octree_node_t>& node_table,
+                                   const std::vector<long>&               ids,
+                                   const std::vector<glm::vec3>&          positions,
+                                   glm::vec3                              target,
+                                   float                                  radius,
+                                   long*                                  result_ids,
+                                   int                                    capacity,
+                                   float*                                 dists_squared)
+{
+    if(radius < 0 || !result_ids || node_table.empty()) {
+        return 0;
+    }
+    int count = 0;
+    find_within_radius_hier(node_table, ids, positions, 0, target, radius * radius, result_ids, capacity, dists_squared, &count);
+    return count;
+}
+
+void flat_octree_dump(const std::vector<flat_octree_node_t>& node_table)
+{
+    for(int i = 0; i < static_cast<int>(node_table.size()); i++) {
+        const flat_octree_node_t &node = node_table[i];
+        std::cout << "node: "          << i                          << std::endl;
+        std::cout << "\tmin: "         << glm::to_string(node.m_min) << std::endl;
+        std::cout << "\tmax: "         << glm::to_string(node.m_max) << std::endl;
+        std::cout << "\tbegin: "       << node.m_begin               << std::endl;
+        std::cout << "\tend: "         << node.m_end                 << std::endl;
+        std::cout << "\tfirst_child: " << node.m_first_child         << std::endl;
+        std::cout << "\tchild_count: " << node.m_child_count         << std::endl;
+        std::cout << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,346 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <HashGrid.h>
+#include <WorkerPool.h>
+#include <Util.h>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#include <math.h>
+
+namespace vt {
+
+HashGrid::HashGrid(glm::vec3 origin,
+                   glm::vec3 dim,
+                   float     cell_size)
+    : m_origin(origin),
+      m_dim(dim),
+      m_cell_size(cell_size),
+      m_is_dirty(false)
+{
+    m_cell_count = glm::ivec3(std::max(static_cast<int>(ceil(dim.x / cell_size)), 1),
+                              std::max(static_cast<int>(ceil(dim.y / cell_size)), 1),
+                              std::max(static_cast<int>(ceil(dim.z / cell_size)), 1));
+    m_cell_offsets.resize(m_cell_count.x * m_cell_count.y * m_cell_count.z + 1, 0);
+}
+
+HashGrid::~HashGrid()
+{
+}
+
+void HashGrid::clear()
+{
+    m_ids.clear();
+    m_positions.clear();
+    m_cells.clear();
+    m_slots.clear();
+    std::fill(m_cell_offsets.begin(), m_cell_offsets.end(), 0);
+    m_cell_slots.clear();
+    m_is_dirty = false;
+}
+
+bool HashGrid::insert(long id, glm::vec3 pos)
+{
+    if(m_slots.find(id) != m_slots.end()) { // object already added?
+        return false;
+    }
+    m_slots[id] = m_ids.size();
+    m_ids.push_back(id);
+    m_positions.push_back(pos);
+    m_cells.push_back(get_cell_index(get_cell_coord(pos)));
+    m_is_dirty = true;
+    return true;
+}
+
+bool HashGrid::remove(long id)
+{
+    std::unordered_map<long, int>::iterator p = m_slots.find(id);
+    if(p == m_slots.end()) {
+        return false;
+    }
+
+    // fill hole with last object
+    int slot      = (*p).second;
+    int last_slot = m_ids.size() - 1;
+    if(slot != last_slot) {
+        m_ids[slot]          = m_ids[last_slot];
+        m_positions[slot]    = m_positions[last_slot];
+        m_cells[slot]        = m_cells[last_slot];
+        m_slots[m_ids[slot]] = slot;
+    }
+    m_ids.pop_back();
+    m_positions.pop_back();
+    m_cells.pop_back();
+    m_slots.erase(id);
+    m_is_dirty = true;
+    return true;
+}
+
+int HashGrid::find(glm::vec3          target,
+                   int                k,
+                   std::vector<long>* nearest_k_vec,
+                   float              radius) const
+{
+    build_if_dirty();
+    if(k <= 0 || m_ids.empty()) {
+        return nearest_k_vec->size();
+    }
+    std::vector<id_dist_t> nearest_k_heap;
+    std::vector<long>      nearest_k_ids(k);
+    int result_size = find_into(target, k, radius, &nearest_k_heap, &nearest_k_ids[0]);
+
+    // copy k elements into more friendly container
+    nearest_k_vec->insert(nearest_k_vec->begin(), nearest_k_ids.begin(), nearest_k_ids.begin() + result_size);
+
+    // return actual result size
+    return nearest_k_vec->size();
+}
+
+int HashGrid::find_batch(const glm::vec3* targets,
+                         size_t           n,
+                         int              k,
+                         float            radius,
+                         long*            nearest_k_ids,
+                         int*             nearest_k_offsets) const
+{
+    if(!targets || !nearest_k_ids || !nearest_k_offsets) {
+        return 0;
+    }
+    if(k <= 0 || m_ids.empty()) {
+        std::fill(nearest_k_offsets, nearest_k_offsets + n + 1, 0);
+        return 0;
+    }
+
+    // build up front; cell buckets must be read-only once threads fan out
+    build_if_dirty();
+    WorkerPool* worker_pool = WorkerPool::instance();
+    std::vector<std::vector<id_dist_t>> thread_heaps(worker_pool->get_thread_count());
+    worker_pool->run(n, [&](int thread_index, size_t begin, size_t end) {
+        std::vector<id_dist_t>* nearest_k_heap = &thread_heaps[thread_index];
+        for(size_t i = begin; i < end; i++) {
+            nearest_k_offsets[i + 1] = find_into(targets[i], k, radius, nearest_k_heap, &nearest_k_ids[i * k]);
+        }
+    });
+    return compact_batch_results(n, k, nearest_k_ids, nearest_k_offsets);
+}
+
+int HashGrid::find_within_radius(glm::vec3 target,
+                                 float     radius,
+                                 long*     ids,
+                                 int       capacity,
+                                 float*    dists_squared) const
+{
+    if(radius < 0 || !ids) {
+        return 0;
+    }
+    build_if_dirty();
+    float      radius_squared = radius * radius;
+    glm::ivec3 min_cell       = get_cell_coord(target - glm::vec3(radius));
+    glm::ivec3 max_cell       = get_cell_coord(target + glm::vec3(radius));
+    int count = 0;
+    for(int z = min_cell.z; z <= max_cell.z; z++) {
+        for(int y = min_cell.y; y <= max_cell.y; y++) {
+            for(int x = min_cell.x; x <= max_cell.x; x++) {
+                int cell_index = get_cell_index(glm::ivec3(x, y, z));
+                for(int i = m_cell_offsets[cell_index]; i < m_cell_offsets[cell_index + 1]; i++) {
+                    int slot = m_cell_slots[i];
+                    glm::vec3 offset = m_positions[slot] - target;
+                    float dist_squared = glm::dot(offset, offset);
+                    if(dist_squared > radius_squared) {
+                        continue;
+                    }
+                    if(count < capacity) {
+                        ids[count] = m_ids[slot];
+                        if(dists_squared) {
+                            dists_squared[count] = dist_squared;
+                        }
+                    }
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+bool HashGrid::exists(long id)
+{
+    return m_slots.find(id) != m_slots.end();
+}
+
+bool HashGrid::move(long id, glm::vec3 pos)
+{
+    std::unordered_map<long, int>::iterator p = m_slots.find(id);
+    if(p == m_slots.end()) {
+        return false;
+    }
+    int slot = (*p).second;
+    int cell = get_cell_index(get_cell_coord(pos));
+    m_positions[slot] = pos;
+    if(cell != m_cells[slot]) { // moves within a cell need no rebuild
+        m_cells[slot] = cell;
+        m_is_dirty = true;
+    }
+    return true;
+}
+
+bool HashGrid::rebalance()
+{
+    if(!m_is_dirty) {
+        return false;
+    }
+    build_if_dirty();
+    return true;
+}
+
+void HashGrid::dump() const
+{
+    build_if_dirty();
+    std::cout << "cell_size: "  << m_cell_size                  << std::endl;
+    std::cout << "cell_count: " << glm::to_string(m_cell_count) << std::endl;
+    for(int i = 0; i < static_cast<int>(m_cell_offsets.size()) - 1; i++) {
+        if(m_cell_offsets[i] == m_cell_offsets[i + 1]) {
+            continue;
+        }
+        std::cout << "cell: " << i << std::endl;
+        for(int j = m_cell_offsets[i]; j < m_cell_offsets[i + 1]; j++) {
+            int slot = m_cell_slots[j];
+            std::cout << "\t" << m_ids[slot] << ": " << glm::to_string(m_positions[slot]) << std::endl;
+        }
+    }
+}
+
+// search cells in rings of increasing chebyshev distance until nothing nearer can remain
+int HashGrid::find_into(glm::vec3               target,
+                        int                     k,
+                        float                   radius,
+                        std::vector<id_dist_t>* nearest_k_heap,
+                        long*                   nearest_k_ids) const
+{
+    nearest_k_heap->clear();
+    nearest_k_heap->reserve(k);
+    float      radius_squared = radius > 0 ? radius * radius : -1;
+    glm::ivec3 center         = get_cell_coord(target);
+    int        max_ring       = std::max(m_cell_count.x, std::max(m_cell_count.y, m_cell_count.z));
+    for(int ring = 0; ring < max_ring; ring++) {
+        if(ring) {
+            // nearest possible distance to any cell not yet visited
+            glm::vec3 visited_min = m_origin + glm::vec3(center - glm::ivec3(ring - 1)) * m_cell_size;
+            glm::vec3 visited_max = m_origin + glm::vec3(center + glm::ivec3(ring))     * m_cell_size;
+            float bound = BIG_NUMBER;
+            for(int i = 0; i < 3; i++) {
+                bound = std::min(bound, std::min(target[i] - visited_min[i], visited_max[i] - target[i]));
+            }
+            bound = std::max(bound, 0.0f); // target outside grid
+            float bound_squared = bound * bound;
+            if(radius_squared > 0 && bound_squared > radius_squared) {
+                break;
+            }
+            if(static_cast<int>(nearest_k_heap->size()) >= k && bound_squared >= nearest_k_heap->front().second) {
+                break;
+            }
+        }
+        glm::ivec3 min_cell = glm::max(center - glm::ivec3(ring), glm::ivec3(0));
+        glm::ivec3 max_cell = glm::min(center + glm::ivec3(ring), m_cell_count - glm::ivec3(1));
+        for(int z = min_cell.z; z <= max_cell.z; z++) {
+            for(int y = min_cell.y; y <= max_cell.y; y++) {
+                bool on_shell = (abs(z - center.z) == ring || abs(y - center.y) == ring);
+                int  x_step   = on_shell ? 1 : ring * 2; // interior rows only touch the two x faces
+                for(int x = center.x - ring; x <= center.x + ring; x += std::max(x_step, 1)) {
+                    if(x < min_cell.x || x > max_cell.x) {
+                        continue;
+                    }
+                    int cell_index = get_cell_index(glm::ivec3(x, y, z));
+                    for(int i = m_cell_offsets[cell_index]; i < m_cell_offsets[cell_index + 1]; i++) {
+                        int slot = m_cell_slots[i];
+                        glm::vec3 offset = m_positions[slot] - target;
+                        float dist_squared = glm::dot(offset, offset);
+                        if(radius_squared > 0 && dist_squared > radius_squared) { // apply radius filter
+                            continue;
+                        }
+                        if(static_cast<int>(nearest_k_heap->size()) < k) {
+                            nearest_k_heap->push_back(id_dist_t(m_ids[slot], dist_squared));
+                            std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+                            continue;
+                        }
+                        if(dist_squared >= nearest_k_heap->front().second) { // no better than current kth nearest
+                            continue;
+                        }
+                        std::pop_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+                        nearest_k_heap->back() = id_dist_t(m_ids[slot], dist_squared);
+                        std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+                    }
+                }
+            }
+        }
+    }
+
+    // sort ascending
+    std::sort_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+    int result_size = nearest_k_heap->size();
+    for(int i = 0; i < result_size; i++) {
+        nearest_k_ids[i] = (*nearest_k_heap)[i].first;
+    }
+    return result_size;
+}
+
+// first reader after a write builds; concurrent readers wait on the lock instead of racing on the buckets
+void HashGrid::build_if_dirty() const
+{
+    if(!m_is_dirty.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_build_mutex);
+    if(m_is_dirty.load(std::memory_order_relaxed)) {
+        build();
+    }
+}
+
+// "counting sort"
+// https://en.wikipedia.org/wiki/Counting_sort
+void HashGrid::build() const
+{
+    std::fill(m_cell_offsets.begin(), m_cell_offsets.end(), 0);
+    for(std::vector<int>::const_iterator p = m_cells.begin(); p != m_cells.end(); ++p) {
+        m_cell_offsets[*p + 1]++;
+    }
+    for(int i = 1; i < static_cast<int>(m_cell_offsets.size()); i++) {
+        m_cell_offsets[i] += m_cell_offsets[i - 1];
+    }
+    std::vector<int> cell_cursors(m_cell_offsets.begin(), m_cell_offsets.end() - 1);
+    m_cell_slots.resize(m_cells.size());
+    for(int slot = 0; slot < static_cast<int>(m_cells.size()); slot++) {
+        m_cell_slots[cell_cursors[m_cells[slot]]++] = slot;
+    }
+    m_is_dirty.store(false, std::memory_order_release);
+}
+
+glm::ivec3 HashGrid::get_cell_coord(glm::vec3 pos) const
+{
+    glm::vec3 cell = (pos - m_origin) * (1.0f / m_cell_size);
+    return glm::ivec3(CLAMP(static_cast<int>(floor(cell.x)), 0, m_cell_count.x - 1),
+                      CLAMP(static_cast<int>(floor(cell.y)), 0, m_cell_count.y - 1),
+                      CLAMP(static_cast<int>(floor(cell.z)), 0, m_cell_count.z - 1));
+}
+
+int HashGrid::get_cell_index(glm::ivec3 cell_coord) const
+{
+    return (cell_coord.z * m_cell_count.y + cell_coord.y) * m_cell_count.x + cell_coord.x;
+}
+
+}
@@ -0,0 +1,308 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <LinearOctree.h>
+#include <FlatOctree.h>
+#include <WorkerPool.h>
+#include <Util.h>
+#include <algorithm>
+#include <vector>
+
+#define NODE_CAPACITY     8
+#define MORTON_LEVELS     21 // 21 bits per axis * 3 axes = 63-bit morton key
+#define MORTON_CELL_COUNT (1 << MORTON_LEVELS)
+
+namespace vt {
+
+// spread lower 21 bits of x so that there are 2 zero bits between each bit
+static uint64_t morton_split_by_3(uint64_t x)
+{
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2)  & 0x1249249249249249ULL;
+    return x;
+}
+
+LinearOctree::LinearOctree(glm::vec3 origin,
+                           glm::vec3 dim)
+    : m_origin(origin),
+      m_dim(dim),
+      m_is_dirty(false)
+{
+}
+
+LinearOctree::~LinearOctree()
+{
+}
+
+void LinearOctree::clear()
+{
+    m_keys.clear();
+    m_ids.clear();
+    m_positions.clear();
+    m_slots.clear();
+    m_node_table.clear();
+    m_is_dirty = false;
+}
+
+bool LinearOctree::insert(long id, glm::vec3 pos)
+{
+    if(m_slots.find(id) != m_slots.end()) { // object already added?
+        return false;
+    }
+    m_slots[id] = m_ids.size();
+    m_keys.push_back(get_morton_key(pos));
+    m_ids.push_back(id);
+    m_positions.push_back(pos);
+    m_is_dirty = true;
+    return true;
+}
+
+bool LinearOctree::remove(long id)
+{
+    std::unordered_map<long, int>::iterator p = m_slots.find(id);
+    if(p == m_slots.end()) {
+        return false;
+    }
+
+    // fill hole with last object
+    int slot      = (*p).second;
+    int last_slot = m_ids.size() - 1;
+    if(slot != last_slot) {
+        m_keys[slot]         = m_keys[last_slot];
+        m_ids[slot]          = m_ids[last_slot];
+        m_positions[slot]    = m_positions[last_slot];
+        m_slots[m_ids[slot]] = slot;
+    }
+    m_keys.pop_back();
+    m_ids.pop_back();
+    m_positions.pop_back();
+    m_slots.erase(id);
+    m_is_dirty = true;
+    return true;
+}
+
+int LinearOctree::find(glm::vec3          target,
+                       int                k,
+                       std::vector<long>* nearest_k_vec,
+                       float              radius) const
+{
+    build_if_dirty();
+    if(k <= 0 || m_node_table.empty()) {
+        return nearest_k_vec->size();
+    }
+    std::vector<id_dist_t> nearest_k_heap;
+    std::vector<long>      nearest_k_ids(k);
+    int result_size = flat_octree_find(m_node_table, m_ids, m_positions, target, k, radius, &nearest_k_heap, &nearest_k_ids[0]);
+
+    // copy k elements into more friendly container
+    nearest_k_vec->insert(nearest_k_vec->begin(), nearest_k_ids.begin(), nearest_k_ids.begin() + result_size);
+
+    // return actual result size
+    return nearest_k_vec->size();
+}
+
+int LinearOctree::find_batch(const glm::vec3* targets,
+                             size_t           n,
+                             int              k,
+                             float            radius,
+                             long*            nearest_k_ids,
+                             int*             nearest_k_offsets) const
+{
+    if(!targets || !nearest_k_ids || !nearest_k_offsets) {
+        return 0;
+    }
+    // build up front; the node table must be read-only once threads fan out
+    // NOTE: build first, since a concurrent build swaps m_ids under a reader that checks it
+    build_if_dirty();
+    if(k <= 0 || m_node_table.empty()) {
+        std::fill(nearest_k_offsets, nearest_k_offsets + n + 1, 0);
+        return 0;
+    }
+    WorkerPool* worker_pool = WorkerPool::instance();
+    std::vector<std::vector<id_dist_t>> thread_heaps(worker_pool->get_thread_count());
+    worker_pool->run(n, [&](int thread_index, size_t begin, size_t end) {
+        std::vector<id_dist_t>* nearest_k_heap = &thread_heaps[thread_index];
+        for(size_t i = begin; i < end; i++) {
+            nearest_k_offsets[i + 1] = flat_octree_find(m_node_table, m_ids, m_positions, targets[i], k, radius, nearest_k_heap, &nearest_k_ids[i * k]);
+        }
+    });
+    return compact_batch_results(n, k, nearest_k_ids, nearest_k_offsets);
+}
+
+int LinearOctree::find_within_radius(glm::vec3 target,
+                                     float     radius,
+                                     long*     ids,
+                                     int       capacity,
+                                     float*    dists_squared) const
+{
+    if(radius < 0 || !ids) {
+        return 0;
+    }
+    build_if_dirty();
+    return flat_octree_find_within_radius(m_node_table, m_ids, m_positions, target, radius, ids, capacity, dists_squared);
+}
+
+bool LinearOctree::exists(long id)
+{
+    return m_slots.find(id) != m_slots.end();
+}
+
+bool LinearOctree::move(long id, glm::vec3 pos)
+{
+    std::unordered_map<long, int>::iterator p = m_slots.find(id);
+    if(p == m_slots.end()) {
+        return false;
+    }
+    int slot = (*p).second;
+    m_keys[slot]      = get_morton_key(pos);
+    m_positions[slot] = pos;
+    m_is_dirty = true;
+    return true;
+}
+
+bool LinearOctree::rebalance()
+{
+    if(!m_is_dirty) {
+        return false;
+    }
+    build_if_dirty();
+    return true;
+}
+
+void LinearOctree::dump() const
+{
+    build_if_dirty();
+    flat_octree_dump(m_node_table);
+}
+
+// first reader after a write builds; concurrent readers wait on the lock instead of racing on the node table
+void LinearOctree::build_if_dirty() const
+{
+    if(!m_is_dirty.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_build_mutex);
+    if(m_is_dirty.load(std::memory_order_relaxed)) {
+        build();
+    }
+}
+
+void LinearOctree::build() const
+{
+    // sort objects by morton key
+    size_t n = m_ids.size();
+    std::vector<std::pair<uint64_t, int>> order(n);
+    for(int i = 0; i < static_cast<int>(n); i++) {
+        order[i] = std::make_pair(m_keys[i], i);
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<uint64_t>  sorted_keys(n);
+    std::vector<long>      sorted_ids(n);
+    std::vector<glm::vec3> sorted_positions(n);
+    for(int i = 0; i < static_cast<int>(n); i++) {
+        int slot = order[i].second;
+        sorted_keys[i]      = m_keys[slot];
+        sorted_ids[i]       = m_ids[slot];
+        sorted_positions[i] = m_positions[slot];
+        m_slots[sorted_ids[i]] = i;
+    }
+    m_keys.swap(sorted_keys);
+    m_ids.swap(sorted_ids);
+    m_positions.swap(sorted_positions);
+
+    // rebuild implicit node table
+    m_node_table.clear();
+    if(n) {
+        flat_octree_node_t root;
+        m_node_table.push_back(root);
+        build_hier(0, 0, n, 0);
+    }
+    m_is_dirty.store(false, std::memory_order_release);
+}
+
+void LinearOctree::build_hier(int node_index, int begin, int end, int depth) const
+{
+    // NOTE: hold indices, not references, since the node table grows during recursion
+    glm::vec3 _min = m_positions[begin];
+    glm::vec3 _max = m_positions[begin];
+    for(int i = begin + 1; i < end; i++) {
+        _min = glm::min(_min, m_positions[i]);
+        _max = glm::max(_max, m_positions[i]);
+    }
+    m_node_table[node_index].m_min         = _min;
+    m_node_table[node_index].m_max         = _max;
+    m_node_table[node_index].m_begin       = begin;
+    m_node_table[node_index].m_end         = end;
+    m_node_table[node_index].m_first_child = -1;
+    m_node_table[node_index].m_child_count = 0;
+    if(end - begin <= NODE_CAPACITY) {
+        return;
+    }
+
+    // skip levels where all objects fall into the same octant
+    // NOTE: objects share the key prefix above depth, so comparing first and last keys suffices
+    while(depth < MORTON_LEVELS) {
+        int shift = 3 * (MORTON_LEVELS - 1 - depth);
+        if(((m_keys[begin] ^ m_keys[end - 1]) >> shift) & 7) {
+            break;
+        }
+        depth++;
+    }
+    if(depth == MORTON_LEVELS) { // coincident objects
+        return;
+    }
+
+    // split range on morton digit at current depth
+    int shift = 3 * (MORTON_LEVELS - 1 - depth);
+    int child_begin[8];
+    int child_end[8];
+    int child_count = 0;
+    for(int i = begin; i < end; i++) {
+        if(i == begin || ((m_keys[i] >> shift) & 7) != ((m_keys[i - 1] >> shift) & 7)) {
+            if(child_count) {
+                child_end[child_count - 1] = i;
+            }
+            child_begin[child_count++] = i;
+        }
+    }
+    child_end[child_count - 1] = end;
+
+    // allocate children contiguously
+    int first_child = m_node_table.size();
+    m_node_table.resize(first_child + child_count);
+    m_node_table[node_index].m_end         = begin; // points belong to the leaves
+    m_node_table[node_index].m_first_child = first_child;
+    m_node_table[node_index].m_child_count = child_count;
+    for(int i = 0; i < child_count; i++) {
+        build_hier(first_child + i, child_begin[i], child_end[i], depth + 1);
+    }
+}
+
+uint64_t LinearOctree::get_morton_key(glm::vec3 pos) const
+{
+    glm::vec3 cell = (pos - m_origin) / m_dim * static_cast<float>(MORTON_CELL_COUNT);
+    uint64_t x = static_cast<uint64_t>(CLAMP(cell.x, 0.0f, static_cast<float>(MORTON_CELL_COUNT - 1)));
+    uint64_t y = static_cast<uint64_t>(CLAMP(cell.y, 0.0f, static_cast<float>(MORTON_CELL_COUNT - 1)));
+    uint64_t z = static_cast<uint64_t>(CLAMP(cell.z, 0.0f, static_cast<float>(MORTON_CELL_COUNT - 1)));
+    return morton_split_by_3(x) | (morton_split_by_3(y) << 1) | (morton_split_by_3(z) << 2);
+}
+
+}
@@ -16,57 +16,168 @@
 // along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <Octree.h>
-#include <TransformObject.h>
-#include <BBoxObject.h>
-#include <PrimitiveFactory.h>
+#include <WorkerPool.h>
+#include <algorithm>
 #include <queue>
+#include <limits>
 #include <map>
 #include <set>
 #include <sstream>
 #include <memory.h>
+#if defined(__AVX__) || defined(__SSE__)
+    #include <immintrin.h>
+#endif
 
-#define NODE_CAPACITY      5
+#define NODE_CAPACITY      OCTREE_LEAF_LANE_COUNT // fill one simd block before splitting
 #define DEPTH_LIMIT        4
 #define EARLY_PRUNE_LEVELS 0 // of questionable benefit
 
 namespace vt {
 
+// unit box corner of each octant; same order as get_octant_index (and PrimitiveFactory::get_box_corners)
+static const glm::vec3 octant_corners[8] = {glm::vec3(0, 0, 0),
+                                            glm::vec3(0, 0, 1),
+                                            glm::vec3(1, 0, 1),
+                                            glm::vec3(1, 0, 0),
+                                            glm::vec3(0, 1, 0),
+                                            glm::vec3(0, 1, 1),
+                                            glm::vec3(1, 1, 1),
+                                            glm::vec3(1, 1, 0)};
+
+// squared distances for one block of leaf lanes; returns bitmask of lanes within threshold
+static inline int calc_leaf_dists_squared(const float* xs,
+                                          const float* ys,
+                                          const float* zs,
+                                          glm::vec3    target,
+                                          float        threshold_squared,
+                                          float*       dists_squared)
+{
+#if defined(__AVX__)
+    __m256 dx = _mm256_sub_ps(_mm256_load_ps(xs), _mm256_set1_ps(target.x));
+    __m256 dy = _mm256_sub_ps(_mm256_load_ps(ys), _mm256_set1_ps(target.y));
+    __m256 dz = _mm256_sub_ps(_mm256_load_ps(zs), _mm256_set1_ps(target.z));
+    __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+    _mm256_store_ps(dists_squared, d2);
+    return _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_set1_ps(threshold_squared), _CMP_LE_OQ));
+#elif defined(__SSE__)
+    int mask = 0;
+    for(int i = 0; i < OCTREE_LEAF_LANE_COUNT; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_load_ps(xs + i), _mm_set1_ps(target.x));
+        __m128 dy = _mm_sub_ps(_mm_load_ps(ys + i), _mm_set1_ps(target.y));
+        __m128 dz = _mm_sub_ps(_mm_load_ps(zs + i), _mm_set1_ps(target.z));
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        _mm_store_ps(dists_squared + i, d2);
+        mask |= _mm_movemask_ps(_mm_cmple_ps(d2, _mm_set1_ps(threshold_squared))) << i;
+    }
+    return mask;
+#else
+    int mask = 0;
+    for(int i = 0; i < OCTREE_LEAF_LANE_COUNT; i++) {
+        float dx = xs[i] - target.x;
+        float dy = ys[i] - target.y;
+        float dz = zs[i] - target.z;
+        dists_squared[i] = dx * dx + dy * dy + dz * dz;
+        if(dists_squared[i] <= threshold_squared) {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
 Octree::Octree(glm::vec3 origin,
                glm::vec3 dim,
                int       index,
                int       depth,
                Octree*   parent,
                Octree*   root)
-    : m_origin(origin),
-      m_dim(dim),
-      m_center(origin + dim * 0.5f),
-      m_index(index),
-      m_depth(depth),
-      m_parent(parent),
-      m_root(parent ? root : this),
-      m_child_count(0)
+    : m_looseness(1),
+      m_track_mass(false),
+      m_node_pool(parent ? NULL : new ObjectPool<Octree>)
 {
-    memset(m_nodes, 0, sizeof(Octree*) * 8);
+    init(origin, dim, index, depth, parent, root);
+}
+
+Octree::Octree()
+    : m_looseness(1),
+      m_track_mass(false),
+      m_node_pool(NULL)
+{
+    init(glm::vec3(0), glm::vec3(0), -1, 0, NULL, NULL);
 }
 
 Octree::~Octree()
 {
-    clear();
+    if(m_node_pool) {
+        delete m_node_pool; // destroys all non-root nodes at once
+    }
+}
+
+void Octree::init(glm::vec3 origin,
+                  glm::vec3 dim,
+                  int       index,
+                  int       depth,
+                  Octree*   parent,
+                  Octree*   root)
+{
+    m_origin      = origin;
+    m_dim         = dim;
+    m_center      = origin + dim * 0.5f;
+    m_index       = index;
+    m_depth       = depth;
+    m_parent      = parent;
+    m_root        = parent ? root : this;
+    m_child_count = 0;
+    memset(m_nodes, 0, sizeof(Octree*) * 8);
+    clear_leaf_objects(); // recycled slots keep leaf capacity
+    m_mass        = 0;
+    m_mass_moment = glm::vec3(0);
 }
 
 void Octree::clear()
 {
-    m_leaf_objects.clear(); // purge leaf contents
+    if(is_root()) {
+        clear_leaf_objects(); // purge leaf contents
+        m_mass        = 0;
+        m_mass_moment = glm::vec3(0);
+        m_object_leaves.clear(); // NOTE: linear in object count, unlike the node reset below
+        m_object_masses.clear();
+        m_node_pool->reset();    // recycle all nodes without visiting them
+        memset(m_nodes, 0, sizeof(Octree*) * 8);
+        m_child_count = 0;
+        return;
+    }
+
+    // detach subtree from ancestor aggregates and root lookups before recycling its nodes
+    for(Octree* node = m_parent; node; node = node->m_parent) {
+        node->m_mass        -= m_mass;
+        node->m_mass_moment -= m_mass_moment;
+    }
+    m_mass        = 0;
+    m_mass_moment = glm::vec3(0);
+    forget_leaf_objects();
+    clear_leaf_objects(); // purge leaf contents
     for(int i = 0; i < 8; i++) {
         if(!m_nodes[i]) {
             continue;
         }
-        delete m_nodes[i];
+        m_nodes[i]->free_hier();
         m_nodes[i] = NULL;
         m_child_count--;
     }
 }
 
+void Octree::free_hier()
+{
+    for(int i = 0; i < 8; i++) {
+        if(m_nodes[i]) {
+            m_nodes[i]->free_hier();
+        }
+    }
+    forget_leaf_objects();
+    m_root->m_node_pool->free(this);
+}
+
 void Octree::prune_empty_nodes()
 {
     for(int i = 0; i < 8; i++) {
@@ -77,7 +188,7 @@ void Octree::prune_empty_nodes()
         if(!m_nodes[i]->is_leaf() || m_nodes[i]->get_leaf_object_count()) {
             continue;
         }
-        delete m_nodes[i];
+        m_root->m_node_pool->free(m_nodes[i]);
         m_nodes[i] = NULL;
         m_child_count--;
     }
@@ -85,52 +196,42 @@ void Octree::prune_empty_nodes()
 
 bool Octree::insert(long id, glm::vec3 pos)
 {
-    if(is_leaf()) { // if leaf
-        if((m_leaf_objects.size() < NODE_CAPACITY || m_depth > DEPTH_LIMIT)) { // if leaf and there's still room or we've reached depth limit
-            if(m_leaf_objects.find(id) != m_leaf_objects.end()) { // object already added?
-                return false;
-            }
-            m_leaf_objects.insert(std::pair<long, glm::vec3>(id, pos)); // add object to leaf
-            return true;
-        }
-        // create sub-nodes and copy leaf contents to sub-nodes
-        for(std::map<long, glm::vec3>::iterator p = m_leaf_objects.begin(); p != m_leaf_objects.end(); ++p) {
-            long      _id  = (*p).first;
-            glm::vec3 _pos = (*p).second;
-            Octree* node = alloc_octant(_pos);
-            if(!node) {
-                continue;
-            }
-            node->insert(_id, _pos);
-        }
-        m_leaf_objects.clear(); // purge leaf contents
+    return insert(id, pos, 1);
+}
+
+bool Octree::insert(long id, glm::vec3 pos, float mass)
+{
+    if(m_root->m_object_leaves.count(id)) { // already indexed, possibly in another leaf
+        return false;
     }
-    Octree* node = alloc_octant(pos);
-    if(!node || !node->insert(id, pos)) { // add object to including node
+    Octree* leaf_node = insert_hier(id, pos);
+    if(!leaf_node) {
         return false;
     }
+    if(mass != 1) {
+        m_root->m_object_masses[id] = mass;
+    }
+    if(m_root->m_track_mass) {
+        leaf_node->update_mass_hier(pos, mass);
+    }
     return true;
 }
 
 bool Octree::remove(long id)
 {
-    if(is_leaf()) {
-        std::map<long, glm::vec3>::iterator p = m_leaf_objects.find(id);
-        if(p == m_leaf_objects.end()) {
-            return false;
-        }
-        m_leaf_objects.erase(p); // remove core action
-        return true;
+    std::unordered_map<long, Octree*>::iterator p = m_root->m_object_leaves.find(id);
+    if(p == m_root->m_object_leaves.end()) {
+        return false;
     }
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
-        }
-        if(m_nodes[i]->remove(id)) {
-            return true;
-        }
+    Octree* leaf_node = (*p).second;
+    int slot = leaf_node->find_leaf_slot(id);
+    if(m_root->m_track_mass) {
+        leaf_node->update_mass_hier(leaf_node->get_leaf_object_pos(slot), -get_object_mass(id));
     }
-    return false;
+    leaf_node->remove_leaf_object(slot); // remove core action
+    m_root->m_object_leaves.erase(p);
+    m_root->m_object_masses.erase(id);
+    return true;
 }
 
 int Octree::find(glm::vec3          target,
@@ -138,36 +239,115 @@ int Octree::find(glm::vec3          target,
                  std::vector<long>* nearest_k_vec,
                  float              radius) const
 {
-    std::priority_queue<id_dist_t, std::vector<id_dist_t>, id_dist_less_than_t> nearest_k_pq;
-    find_hier(target, k, &nearest_k_pq, true, radius);
-
-    // reverse order and copy k elements into more friendly container
-    int i = nearest_k_pq.size() - 1;
-    while(nearest_k_pq.size()) {
-        if(i < k) {
-            nearest_k_vec->insert(nearest_k_vec->begin(), nearest_k_pq.top().first);
-        }
-        nearest_k_pq.pop();
-        i--;
+    if(k <= 0) {
+        return nearest_k_vec->size();
     }
+    std::vector<id_dist_t> nearest_k_heap;
+    std::vector<long>      nearest_k_ids(k);
+    int result_size = find_into(target, k, radius, &nearest_k_heap, &nearest_k_ids[0]);
+
+    // copy k elements into more friendly container
+    nearest_k_vec->insert(nearest_k_vec->begin(), nearest_k_ids.begin(), nearest_k_ids.begin() + result_size);
 
     // return actual result size
     return nearest_k_vec->size();
 }
 
-void Octree::find_hier(glm::vec3                                                                    target,
-                       int                                                                          k,
-                       std::priority_queue<id_dist_t, std::vector<id_dist_t>, id_dist_less_than_t>* nearest_k_pq,
-                       bool                                                                         is_direct_lineage,
-                       float                                                                        radius) const
+int Octree::find_batch(const glm::vec3* targets,
+                       size_t           n,
+                       int              k,
+                       float            radius,
+                       long*            nearest_k_ids,
+                       int*             nearest_k_offsets) const
 {
+    return find_batch_approx(targets, n, k, radius, 0, -1, nearest_k_ids, nearest_k_offsets); // exact
+}
+
+int Octree::find_approx(glm::vec3          target,
+                        int                k,
+                        std::vector<long>* nearest_k_vec,
+                        float              eps,
+                        int                max_leaf_visits,
+                        float              radius) const
+{
+    if(k <= 0) {
+        return nearest_k_vec->size();
+    }
+    std::vector<id_dist_t> nearest_k_heap;
+    std::vector<long>      nearest_k_ids(k);
+    int result_size = find_into(target, k, radius, &nearest_k_heap, &nearest_k_ids[0], eps, max_leaf_visits);
+    nearest_k_vec->insert(nearest_k_vec->begin(), nearest_k_ids.begin(), nearest_k_ids.begin() + result_size);
+    return nearest_k_vec->size();
+}
+
+int Octree::find_batch_approx(const glm::vec3* targets,
+                              size_t           n,
+                              int              k,
+                              float            radius,
+                              float            eps,
+                              int              max_leaf_visits,
+                              long*            nearest_k_ids,
+                              int*             nearest_k_offsets) const
+{
+    if(!targets || !nearest_k_ids || !nearest_k_offsets) {
+        return 0;
+    }
+    nearest_k_offsets[0] = 0;
+    if(k <= 0) {
+        std::fill(nearest_k_offsets, nearest_k_offsets + n + 1, 0);
+        return 0;
+    }
+
+    // tree is read-only during queries, so fan out with one scratch heap per thread
+    // each query writes into its own k-sized slot; sizes are parked in offsets[i + 1]
+    WorkerPool* worker_pool = WorkerPool::instance();
+    std::vector<std::vector<id_dist_t>> thread_heaps(worker_pool->get_thread_count());
+    worker_pool->run(n, [&](int thread_index, size_t begin, size_t end) {
+        std::vector<id_dist_t>* nearest_k_heap = &thread_heaps[thread_index];
+        for(size_t i = begin; i < end; i++) {
+            nearest_k_offsets[i + 1] = find_into(targets[i], k, radius, nearest_k_heap, &nearest_k_ids[i * k], eps, max_leaf_visits);
+        }
+    });
+    return compact_batch_results(n, k, nearest_k_ids, nearest_k_offsets);
+}
+
+int Octree::find_into(glm::vec3               target,
+                      int                     k,
+                      float                   radius,
+                      std::vector<id_dist_t>* nearest_k_heap,
+                      long*                   nearest_k_ids,
+                      float                   eps,
+                      int                     max_leaf_visits) const
+{
+    nearest_k_heap->clear();
+    float approx_factor = 1 + std::max(eps, 0.0f);
+    int   leaf_budget   = max_leaf_visits;
+    find_hier(target, k, nearest_k_heap, true, radius, approx_factor * approx_factor, max_leaf_visits < 0 ? NULL : &leaf_budget);
+
+    // sort ascending and keep k nearest
+    std::sort_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+    int result_size = std::min(static_cast<int>(nearest_k_heap->size()), k);
+    for(int i = 0; i < result_size; i++) {
+        nearest_k_ids[i] = (*nearest_k_heap)[i].first;
+    }
+    return result_size;
+}
+
+void Octree::find_hier(glm::vec3               target,
+                       int                     k,
+                       std::vector<id_dist_t>* nearest_k_heap,
+                       bool                    is_direct_lineage,
+                       float                   radius,
+                       float                   approx_factor_squared,
+                       int*                    leaf_budget) const
+{
+    if(leaf_budget && *leaf_budget <= 0 && nearest_k_heap->size()) { // out of budget; settle for what we have
+        return;
+    }
+
     // apply early prune near root; theoretically efficient, in practice very expensive
-    if(m_depth <= EARLY_PRUNE_LEVELS) {
-        TransformObject transform_object("", m_origin);
-        if(!BBoxObject(glm::vec3(0), m_dim).is_sphere_collide(&transform_object,
-                                                              target,
-                                                              radius))
-        {
+    if(radius > 0 && m_depth <= EARLY_PRUNE_LEVELS) {
+        if(glm::distance(glm::clamp(target, m_origin, m_origin + m_dim), target) > radius) { // sphere misses node box
             return;
         }
     }
@@ -177,13 +357,38 @@ void Octree::find_hier(glm::vec3
     //==========
 
     if(is_leaf()) {
-        for(std::map<long, glm::vec3>::const_iterator p = m_leaf_objects.begin(); p != m_leaf_objects.end(); ++p) {
-            long      id  = (*p).first;
-            glm::vec3 pos = (*p).second;
-            if(radius > 0 && glm::distance(pos, target) > radius) { // apply radius filter
-                continue;
+        if(leaf_budget) {
+            (*leaf_budget)--;
+        }
+
+        // bounded max-heap keyed on squared distance; only candidates within current kth nearest touch the heap
+        float radius_squared = radius > 0 ? radius * radius : std::numeric_limits<float>::max();
+        int   n              = m_leaf_ids.size();
+        for(int i = 0; i < n; i += OCTREE_LEAF_LANE_COUNT) {
+            float threshold_squared = radius_squared;
+            if(static_cast<int>(nearest_k_heap->size()) >= k) {
+                threshold_squared = std::min(threshold_squared, nearest_k_heap->front().second);
+            }
+            float dists_squared[OCTREE_LEAF_LANE_COUNT] __attribute__((aligned(OCTREE_LEAF_ALIGNMENT)));
+            int mask = calc_leaf_dists_squared(&m_leaf_xs[i], &m_leaf_ys[i], &m_leaf_zs[i], target, threshold_squared, dists_squared);
+            if(n - i < OCTREE_LEAF_LANE_COUNT) {
+                mask &= (1 << (n - i)) - 1; // ignore padding lanes
+            }
+            for(; mask; mask &= mask - 1) {
+                int   j            = __builtin_ctz(mask);
+                float dist_squared = dists_squared[j];
+                if(static_cast<int>(nearest_k_heap->size()) < k) {
+                    nearest_k_heap->push_back(id_dist_t(m_leaf_ids[i + j], dist_squared));
+                    std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+                    continue;
+                }
+                if(dist_squared >= nearest_k_heap->front().second) { // no better than current kth nearest
+                    continue;
+                }
+                std::pop_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
+                nearest_k_heap->back() = id_dist_t(m_leaf_ids[i + j], dist_squared);
+                std::push_heap(nearest_k_heap->begin(), nearest_k_heap->end(), id_dist_less_than_t());
             }
-            nearest_k_pq->push(id_dist_t(id, glm::distance(pos, target))); // record ALL visited objects (filtered)
         }
         return;
     }
@@ -199,7 +404,7 @@ void Octree::find_hier(glm::vec3
 
     // search best-candidate octant
     if(m_nodes[octant_index]) {
-        m_nodes[octant_index]->find_hier(target, k, nearest_k_pq, is_direct_lineage, radius);
+        m_nodes[octant_index]->find_hier(target, k, nearest_k_heap, is_direct_lineage, radius, approx_factor_squared, leaf_budget);
     }
 
     // stop here if best-candidate octant results sufficient
@@ -236,7 +441,7 @@ void Octree::find_hier(glm::vec3
     // |               |       |     A |
     // +---------------+-------+-------+
 
-    // get nearest wall distance
+    // get nearest wall distance of best-candidate octant (outer walls or center planes)
     float nearest_wall_distance = BIG_NUMBER;
     nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.x - m_origin.x)));
     nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.y - m_origin.y)));
@@ -245,10 +450,17 @@ void Octree::find_hier(glm::vec3
     nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.x - opposite.x)));
     nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.y - opposite.y)));
     nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.z - opposite.z)));
-
-    float farthest_object_distance = nearest_k_pq->size() ? nearest_k_pq->top().second : 0;
-    bool should_search_siblings = !is_direct_lineage || (farthest_object_distance > nearest_wall_distance);
-    if(static_cast<int>(nearest_k_pq->size()) >= k && !should_search_siblings) {
+    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.x - m_center.x)));
+    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.y - m_center.y)));
+    nearest_wall_distance = std::min(nearest_wall_distance, static_cast<float>(fabs(target.z - m_center.z)));
+    float octant_slack = std::max(m_dim.x, std::max(m_dim.y, m_dim.z)) * 0.5f * (m_root->m_looseness - 1) * 0.5f;
+    nearest_wall_distance -= octant_slack; // sibling objects may straddle walls by up to slack in loose mode
+
+    // approximate mode shrinks the kth nearest distance by (1 + eps) before comparing
+    float farthest_object_distance_squared = nearest_k_heap->size() ? nearest_k_heap->front().second : 0;
+    bool should_search_siblings = !is_direct_lineage || nearest_wall_distance < 0 ||
+                                  (farthest_object_distance_squared > nearest_wall_distance * nearest_wall_distance * approx_factor_squared);
+    if(static_cast<int>(nearest_k_heap->size()) >= k && !should_search_siblings) {
         return;
     }
 
@@ -257,51 +469,54 @@ void Octree::find_hier(glm::vec3
         if(i == octant_index) { // skip best-candidate octant (already searched)
             continue;
         }
-        if(m_nodes[i]) {
-            m_nodes[i]->find_hier(target, k, nearest_k_pq, false, radius);
+        if(!m_nodes[i]) {
+            continue;
         }
+        if(approx_factor_squared > 1 && static_cast<int>(nearest_k_heap->size()) >= k) {
+            // skip sibling if its (loose) bounds can't improve on (1 + eps) of current kth nearest
+            const Octree* node    = m_nodes[i];
+            glm::vec3     slack   = glm::vec3(node->get_slack());
+            glm::vec3     nearest = glm::clamp(target, node->m_origin - slack, node->m_origin + node->m_dim + slack);
+            glm::vec3     offset  = nearest - target;
+            if(glm::dot(offset, offset) * approx_factor_squared >= nearest_k_heap->front().second) {
+                continue;
+            }
+        }
+        m_nodes[i]->find_hier(target, k, nearest_k_heap, false, radius, approx_factor_squared, leaf_budget);
     }
 }
 
-bool Octree::exists(long id)
+// streams ids into caller-owned buffer without sorting; returns total match count (may exceed capacity)
+int Octree::find_within_radius(glm::vec3 target,
+                               float     radius,
+                               long*     ids,
+                               int       capacity,
+                               float*    dists_squared) const
 {
-    if(is_leaf()) {
-        std::map<long, glm::vec3>::iterator p = m_leaf_objects.find(id);
-        if(p != m_leaf_objects.end()) {
-            return true; // find core action
-        }
-        return false;
-    }
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
-        }
-        if(m_nodes[i]->exists(id)) {
-            return true;
-        }
+    if(radius < 0 || !ids) {
+        return 0;
     }
-    return false;
+    int count = 0;
+    find_within_radius_hier(target, radius * radius, ids, capacity, dists_squared, &count);
+    return count;
+}
+
+bool Octree::exists(long id)
+{
+    return m_root->m_object_leaves.find(id) != m_root->m_object_leaves.end();
 }
 
 bool Octree::move(long id, glm::vec3 pos)
 {
-    if(is_leaf()) {
-        std::map<long, glm::vec3>::iterator p = m_leaf_objects.find(id);
-        if(p != m_leaf_objects.end()) {
-            (*p).second = pos; // move core action
-            return true;
-        }
+    std::unordered_map<long, Octree*>::iterator p = m_root->m_object_leaves.find(id);
+    if(p == m_root->m_object_leaves.end()) {
         return false;
     }
-    for(int i = 0; i < 8; i++) {
-        if(!m_nodes[i]) {
-            continue;
-        }
-        if(m_nodes[i]->move(id, pos)) {
-            return true;
-        }
+    Octree* leaf_node = (*p).second;
+    if(leaf_node->relocate(id, pos) != leaf_node) {
+        leaf_node->prune_empty_lineage();
     }
-    return false;
+    return true;
 }
 
 bool Octree::rebalance()
@@ -309,35 +524,22 @@ bool Octree::rebalance()
     bool changed = false;
     if(is_leaf()) {
         std::vector<long> remove_vec;
-        for(std::map<long, glm::vec3>::iterator p = m_leaf_objects.begin(); p != m_leaf_objects.end(); ++p) {
-            long      id  = (*p).first;
-            glm::vec3 pos = (*p).second;
-            if(!within_bbox(pos)) {
-                remove_vec.push_back(id);
+        for(int i = 0; i < static_cast<int>(m_leaf_ids.size()); i++) {
+            if(!within_loose_bbox(get_leaf_object_pos(i))) {
+                remove_vec.push_back(m_leaf_ids[i]);
             }
         }
         for(std::vector<long>::iterator q = remove_vec.begin(); q != remove_vec.end(); ++q) {
             long id = *q;
-            std::map<long, glm::vec3>::iterator r = m_leaf_objects.find(id);
-            if(r == m_leaf_objects.end()) {
-                continue;
-            }
-
-            // remove from subtree
-            if(!remove(id)) {
+            int slot = find_leaf_slot(id);
+            if(slot == -1) {
                 continue;
             }
 
-            // add back to first including parent node
-            glm::vec3 pos = (*r).second;
-            Octree* node = first_including_parent_node(pos);
-            if(node) {
-                if(!node->insert(id, pos)) {
-                    continue;
-                }
+            // move to first including parent node
+            if(relocate(id, get_leaf_object_pos(slot)) != this) {
+                changed = true;
             }
-
-            changed = true;
         }
         return changed;
     }
@@ -353,6 +555,83 @@ bool Octree::rebalance()
     return changed;
 }
 
+void Octree::set_looseness(float looseness)
+{
+    m_root->m_looseness = std::max(looseness, 1.0f);
+}
+
+void Octree::set_track_mass(bool track_mass)
+{
+    if(!is_root()) {
+        m_root->set_track_mass(track_mass);
+        return;
+    }
+    if(track_mass && !m_track_mass) {
+        rebuild_mass_hier();
+    }
+    m_track_mass = track_mass;
+}
+
+float Octree::get_object_mass(long id) const
+{
+    std::map<long, float>::const_iterator p = m_root->m_object_masses.find(id);
+    if(p == m_root->m_object_masses.end()) {
+        return 1; // unit mass unless specified
+    }
+    return (*p).second;
+}
+
+// "barnes-hut simulation"
+// https://en.wikipedia.org/wiki/Barnes%E2%80%93Hut_simulation
+glm::vec3 Octree::accumulate_force(glm::vec3 pos, float theta, float softening) const
+{
+    if(!m_root->m_track_mass || m_mass <= 0) { // mass tracking disabled (aggregates are stale) or empty subtree
+        return glm::vec3(0);
+    }
+    float softening_squared = softening * softening;
+
+    //==========
+    // leaf node
+    //==========
+
+    if(is_leaf()) {
+        glm::vec3 force(0);
+        for(int i = 0; i < static_cast<int>(m_leaf_ids.size()); i++) {
+            glm::vec3 offset = get_leaf_object_pos(i) - pos;
+            float dist_squared = glm::dot(offset, offset);
+            if(dist_squared < EPSILON * EPSILON) { // ignore self
+                continue;
+            }
+            dist_squared += softening_squared;
+            force += offset * (get_object_mass(m_leaf_ids[i]) / (dist_squared * glm::sqrt(dist_squared)));
+        }
+        return force;
+    }
+
+    //==============
+    // internal node
+    //==============
+
+    // treat far away subtree as single point mass at its center of mass
+    glm::vec3 offset = m_mass_moment * (1.0f / m_mass) - pos;
+    float dist_squared = glm::dot(offset, offset);
+    float node_size    = std::max(m_dim.x, std::max(m_dim.y, m_dim.z)) + get_slack() * 2;
+    if(!within_loose_bbox(pos) && node_size * node_size < theta * theta * dist_squared) {
+        dist_squared += softening_squared;
+        return offset * (m_mass / (dist_squared * glm::sqrt(dist_squared)));
+    }
+
+    // otherwise open node
+    glm::vec3 force(0);
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        force += m_nodes[i]->accumulate_force(pos, theta, softening);
+    }
+    return force;
+}
+
 std::string Octree::get_name() const
 {
     std::stringstream ss;
@@ -387,6 +666,239 @@ void Octree::dump() const
     indent--;
 }
 
+void Octree::find_within_radius_hier(glm::vec3 target,
+                                     float     radius_squared,
+                                     long*     ids,
+                                     int       capacity,
+                                     float*    dists_squared,
+                                     int*      count) const
+{
+    // skip node if sphere misses (loose) bounds
+    if(!is_root()) {
+        glm::vec3 slack   = glm::vec3(get_slack());
+        glm::vec3 nearest = glm::clamp(target, m_origin - slack, m_origin + m_dim + slack);
+        glm::vec3 offset  = nearest - target;
+        if(glm::dot(offset, offset) > radius_squared) {
+            return;
+        }
+    }
+
+    //==========
+    // leaf node
+    //==========
+
+    if(is_leaf()) {
+        int n = m_leaf_ids.size();
+        for(int i = 0; i < n; i += OCTREE_LEAF_LANE_COUNT) {
+            float block_dists_squared[OCTREE_LEAF_LANE_COUNT] __attribute__((aligned(OCTREE_LEAF_ALIGNMENT)));
+            int mask = calc_leaf_dists_squared(&m_leaf_xs[i], &m_leaf_ys[i], &m_leaf_zs[i], target, radius_squared, block_dists_squared);
+            if(n - i < OCTREE_LEAF_LANE_COUNT) {
+                mask &= (1 << (n - i)) - 1; // ignore padding lanes
+            }
+            for(; mask; mask &= mask - 1) {
+                int j = __builtin_ctz(mask);
+                if(*count < capacity) {
+                    ids[*count] = m_leaf_ids[i + j];
+                    if(dists_squared) {
+                        dists_squared[*count] = block_dists_squared[j];
+                    }
+                }
+                (*count)++;
+            }
+        }
+        return;
+    }
+
+    //==============
+    // internal node
+    //==============
+
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        m_nodes[i]->find_within_radius_hier(target, radius_squared, ids, capacity, dists_squared, count);
+    }
+}
+
+int Octree::find_leaf_slot(long id) const
+{
+    std::vector<long>::const_iterator p = std::find(m_leaf_ids.begin(), m_leaf_ids.end(), id);
+    if(p == m_leaf_ids.end()) {
+        return -1;
+    }
+    return p - m_leaf_ids.begin();
+}
+
+glm::vec3 Octree::get_leaf_object_pos(int slot) const
+{
+    return glm::vec3(m_leaf_xs[slot], m_leaf_ys[slot], m_leaf_zs[slot]);
+}
+
+void Octree::set_leaf_object_pos(int slot, glm::vec3 pos)
+{
+    m_leaf_xs[slot] = pos.x;
+    m_leaf_ys[slot] = pos.y;
+    m_leaf_zs[slot] = pos.z;
+}
+
+void Octree::add_leaf_object(long id, glm::vec3 pos)
+{
+    int slot = m_leaf_ids.size();
+    if(slot == static_cast<int>(m_leaf_xs.size())) { // grow by one whole simd block
+        m_leaf_xs.resize(slot + OCTREE_LEAF_LANE_COUNT, 0);
+        m_leaf_ys.resize(slot + OCTREE_LEAF_LANE_COUNT, 0);
+        m_leaf_zs.resize(slot + OCTREE_LEAF_LANE_COUNT, 0);
+    }
+    m_leaf_ids.push_back(id);
+    set_leaf_object_pos(slot, pos);
+}
+
+void Octree::remove_leaf_object(int slot)
+{
+    // fill hole with last object
+    int last_slot = m_leaf_ids.size() - 1;
+    if(slot != last_slot) {
+        m_leaf_ids[slot] = m_leaf_ids[last_slot];
+        set_leaf_object_pos(slot, get_leaf_object_pos(last_slot));
+    }
+    m_leaf_ids.pop_back();
+    if(m_leaf_ids.size() + OCTREE_LEAF_LANE_COUNT == m_leaf_xs.size()) { // shrink by one whole simd block
+        m_leaf_xs.resize(m_leaf_ids.size());
+        m_leaf_ys.resize(m_leaf_ids.size());
+        m_leaf_zs.resize(m_leaf_ids.size());
+    }
+}
+
+void Octree::forget_leaf_objects()
+{
+    for(std::vector<long>::iterator p = m_leaf_ids.begin(); p != m_leaf_ids.end(); ++p) {
+        m_root->m_object_leaves.erase(*p);
+        m_root->m_object_masses.erase(*p);
+    }
+}
+
+void Octree::clear_leaf_objects()
+{
+    m_leaf_ids.clear();
+    m_leaf_xs.clear();
+    m_leaf_ys.clear();
+    m_leaf_zs.clear();
+}
+
+Octree* Octree::insert_hier(long id, glm::vec3 pos)
+{
+    if(is_leaf()) { // if leaf
+        if((m_leaf_ids.size() < NODE_CAPACITY || m_depth > DEPTH_LIMIT)) { // if leaf and there's still room or we've reached depth limit
+            if(find_leaf_slot(id) != -1) { // object already added?
+                return NULL;
+            }
+            add_leaf_object(id, pos); // add object to leaf
+            m_root->m_object_leaves[id] = this;
+            return this;
+        }
+        // create sub-nodes and copy leaf contents to sub-nodes
+        std::vector<long> leaf_ids;
+        leaf_ids.swap(m_leaf_ids);
+        for(int i = 0; i < static_cast<int>(leaf_ids.size()); i++) {
+            long      _id  = leaf_ids[i];
+            glm::vec3 _pos = glm::vec3(m_leaf_xs[i], m_leaf_ys[i], m_leaf_zs[i]);
+            Octree* node = alloc_octant(_pos);
+            if(!node) {
+                m_root->m_object_leaves.erase(_id);
+                continue;
+            }
+            Octree* leaf_node = node->insert_hier(_id, _pos);
+            if(leaf_node && m_root->m_track_mass) {
+                leaf_node->update_mass_hier(_pos, get_object_mass(_id), this); // already counted from here up
+            }
+        }
+        clear_leaf_objects(); // purge leaf contents
+    }
+    Octree* node = alloc_octant(pos);
+    if(!node) {
+        return NULL;
+    }
+    return node->insert_hier(id, pos); // add object to including node
+}
+
+Octree* Octree::relocate(long id, glm::vec3 pos)
+{
+    int slot = find_leaf_slot(id);
+    if(slot == -1) {
+        return NULL;
+    }
+    float mass = get_object_mass(id);
+
+    // stay in place while within slack (or if outside root entirely)
+    Octree* node = within_loose_bbox(pos) ? NULL : first_including_parent_node(pos);
+    if(!node) {
+        if(m_root->m_track_mass) {
+            update_mass_hier(get_leaf_object_pos(slot), -mass);
+            update_mass_hier(pos, mass);
+        }
+        set_leaf_object_pos(slot, pos); // move core action
+        return this;
+    }
+
+    // crossed cell boundary; re-insert under first including parent node
+    if(m_root->m_track_mass) {
+        update_mass_hier(get_leaf_object_pos(slot), -mass);
+    }
+    remove_leaf_object(slot);
+    Octree* leaf_node = node->insert_hier(id, pos);
+    if(!leaf_node) {
+        m_root->m_object_leaves.erase(id);
+        return NULL;
+    }
+    if(m_root->m_track_mass) {
+        leaf_node->update_mass_hier(pos, mass);
+    }
+    return leaf_node;
+}
+
+void Octree::prune_empty_lineage()
+{
+    Octree* node = this;
+    while(!node->is_root() && node->is_leaf() && !node->get_leaf_object_count()) {
+        Octree* parent = node->m_parent;
+        parent->m_nodes[node->m_index] = NULL;
+        parent->m_child_count--;
+        m_root->m_node_pool->free(node);
+        node = parent;
+    }
+}
+
+void Octree::update_mass_hier(glm::vec3 pos, float mass, const Octree* stop_node)
+{
+    for(Octree* node = this; node && node != stop_node; node = node->m_parent) {
+        node->m_mass        += mass;
+        node->m_mass_moment += pos * mass;
+    }
+}
+
+void Octree::rebuild_mass_hier()
+{
+    m_mass        = 0;
+    m_mass_moment = glm::vec3(0);
+    if(is_leaf()) {
+        for(int i = 0; i < static_cast<int>(m_leaf_ids.size()); i++) {
+            float mass = get_object_mass(m_leaf_ids[i]);
+            m_mass        += mass;
+            m_mass_moment += get_leaf_object_pos(i) * mass;
+        }
+        return;
+    }
+    for(int i = 0; i < 8; i++) {
+        if(!m_nodes[i]) {
+            continue;
+        }
+        m_nodes[i]->rebuild_mass_hier();
+        m_mass        += m_nodes[i]->m_mass;
+        m_mass_moment += m_nodes[i]->m_mass_moment;
+    }
+}
+
 Octree* Octree::alloc_octant(glm::vec3 pos)
 {
     int octant_index = get_octant_index(pos);
@@ -394,10 +906,10 @@ Octree* Octree::alloc_octant(glm::vec3 pos)
         return NULL;
     }
     if(!m_nodes[octant_index]) {
-        glm::vec3 points[8];
         glm::vec3 half_dim = m_dim * 0.5f;
-        vt::PrimitiveFactory::get_box_corners(points, &m_origin, &half_dim);
-        m_nodes[octant_index] = new Octree(points[octant_index], half_dim, octant_index, m_depth + 1, this, m_root);
+        Octree* node = m_root->m_node_pool->alloc();
+        node->init(m_origin + octant_corners[octant_index] * half_dim, half_dim, octant_index, m_depth + 1, this, m_root);
+        m_nodes[octant_index] = node;
         m_child_count++;
     }
     return m_nodes[octant_index];
@@ -473,4 +985,21 @@ bool Octree::within_bbox(glm::vec3 pos) const
            (min.z <= pos.z && pos.z <= max.z);
 }
 
+bool Octree::within_loose_bbox(glm::vec3 pos) const
+{
+    glm::vec3 min = m_origin - glm::vec3(get_slack());
+    glm::vec3 max = m_origin + m_dim + glm::vec3(get_slack());
+    return (min.x <= pos.x && pos.x <= max.x) &&
+           (min.y <= pos.y && pos.y <= max.y) &&
+           (min.z <= pos.z && pos.z <= max.z);
+}
+
+float Octree::get_slack() const
+{
+    if(is_root()) { // root bounds stay tight
+        return 0;
+    }
+    return std::max(m_dim.x, std::max(m_dim.y, m_dim.z)) * (m_root->m_looseness - 1) * 0.5f;
+}
+
 }
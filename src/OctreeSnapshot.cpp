@@ -0,0 +1,159 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <OctreeSnapshot.h>
+#include <Octree.h>
+#include <WorkerPool.h>
+#include <Util.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <iostream>
+
+namespace vt {
+
+OctreeSnapshot::OctreeSnapshot()
+    : m_origin(0),
+      m_dim(0),
+      m_generation(0)
+{
+}
+
+OctreeSnapshot::~OctreeSnapshot()
+{
+}
+
+void OctreeSnapshot::clear()
+{
+    m_ids.clear();
+    m_positions.clear();
+    m_node_table.clear();
+}
+
+void OctreeSnapshot::build(const Octree* octree)
+{
+    clear();
+    m_generation++;
+    if(!octree) {
+        return;
+    }
+    octree   = octree->get_root();
+    m_origin = octree->get_origin();
+    m_dim    = octree->get_dim();
+
+    // flatten breadth-first so that siblings land next to each other
+    m_build_queue.clear();
+    m_build_queue.push_back(octree);
+    for(size_t i = 0; i < m_build_queue.size(); i++) {
+        const Octree* node = m_build_queue[i];
+        flat_octree_node_t snapshot_node;
+        snapshot_node.m_begin = m_ids.size();
+        for(int j = 0; j < static_cast<int>(node->m_leaf_ids.size()); j++) {
+            m_ids.push_back(node->m_leaf_ids[j]);
+            m_positions.push_back(node->get_leaf_object_pos(j));
+        }
+        snapshot_node.m_end         = m_ids.size();
+        snapshot_node.m_first_child = m_build_queue.size();
+        snapshot_node.m_child_count = 0;
+        for(int j = 0; j < 8; j++) {
+            if(!node->m_nodes[j]) {
+                continue;
+            }
+            m_build_queue.push_back(node->m_nodes[j]);
+            snapshot_node.m_child_count++;
+        }
+        m_node_table.push_back(snapshot_node);
+    }
+
+    // tighten bounds bottom-up; children always follow their parent
+    for(int i = m_node_table.size() - 1; i >= 0; i--) {
+        flat_octree_node_t &node = m_node_table[i];
+        node.m_min = glm::vec3(std::numeric_limits<float>::max());
+        node.m_max = glm::vec3(-std::numeric_limits<float>::max());
+        for(int j = node.m_begin; j < node.m_end; j++) {
+            node.m_min = glm::min(node.m_min, m_positions[j]);
+            node.m_max = glm::max(node.m_max, m_positions[j]);
+        }
+        for(int j = 0; j < node.m_child_count; j++) {
+            const flat_octree_node_t &child = m_node_table[node.m_first_child + j];
+            node.m_min = glm::min(node.m_min, child.m_min);
+            node.m_max = glm::max(node.m_max, child.m_max);
+        }
+    }
+}
+
+int OctreeSnapshot::find(glm::vec3          target,
+                         int                k,
+                         std::vector<long>* nearest_k_vec,
+                         float              radius) const
+{
+    if(k <= 0 || m_ids.empty()) {
+        return nearest_k_vec->size();
+    }
+    std::vector<id_dist_t> nearest_k_heap;
+    std::vector<long>      nearest_k_ids(k);
+    int result_size = flat_octree_find(m_node_table, m_ids, m_positions, target, k, radius, &nearest_k_heap, &nearest_k_ids[0]);
+
+    // copy k elements into more friendly container
+    nearest_k_vec->insert(nearest_k_vec->begin(), nearest_k_ids.begin(), nearest_k_ids.begin() + result_size);
+
+    // return actual result size
+    return nearest_k_vec->size();
+}
+
+int OctreeSnapshot::find_batch(const glm::vec3* targets,
+                               size_t           n,
+                               int              k,
+                               float            radius,
+                               long*            nearest_k_ids,
+                               int*             nearest_k_offsets) const
+{
+    if(!targets || !nearest_k_ids || !nearest_k_offsets) {
+        return 0;
+    }
+    if(k <= 0 || m_ids.empty()) {
+        std::fill(nearest_k_offsets, nearest_k_offsets + n + 1, 0);
+        return 0;
+    }
+    WorkerPool* worker_pool = WorkerPool::instance();
+    std::vector<std::vector<id_dist_t>> thread_heaps(worker_pool->get_thread_count());
+    worker_pool->run(n, [&](int thread_index, size_t begin, size_t end) {
+        std::vector<id_dist_t>* nearest_k_heap = &thread_heaps[thread_index];
+        for(size_t i = begin; i < end; i++) {
+            nearest_k_offsets[i + 1] = flat_octree_find(m_node_table, m_ids, m_positions, targets[i], k, radius, nearest_k_heap, &nearest_k_ids[i * k]);
+        }
+    });
+
+    return compact_batch_results(n, k, nearest_k_ids, nearest_k_offsets);
+}
+
+int OctreeSnapshot::find_within_radius(glm::vec3 target,
+                                       float     radius,
+                                       long*     ids,
+                                       int       capacity,
+                                       float*    dists_squared) const
+{
+    return flat_octree_find_within_radius(m_node_table, m_ids, m_positions, target, radius, ids, capacity, dists_squared);
+}
+
+void OctreeSnapshot::dump() const
+{
+    std::cout << "generation: " << m_generation << std::endl;
+    flat_octree_dump(m_node_table);
+}
+
+}
@@ -16,32 +16,126 @@
 // along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <PRM.h>
+#include <Random.h>
 #include <Util.h>
+#include <WorkerPool.h>
+#include <algorithm>
 #include <vector>
-#include <set>
 #include <tuple>
+#include <utility>
+#include <string>
+#include <iostream> // std::cerr
 #include <glm/glm.hpp>
 #include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PRM_FILE_MAGIC     "VTPRM\0\0\0"
+#define PRM_FILE_VERSION   1
+#define PRM_FILE_ALIGNMENT 8
 
 namespace vt {
 
-PRM_Waypoint::PRM_Waypoint(glm::vec3 origin)
-    : m_origin(origin)
+// on-disk roadmap layout; all fields little-endian, each section starts on an 8-byte boundary
+// NOTE: sections mirror the in-memory csr arrays, so a mapped file is usable without parsing
+struct prm_file_header_t
+{
+    char     m_magic[8];
+    uint32_t m_version;
+    uint32_t m_header_size;
+    uint64_t m_waypoint_count;
+    uint64_t m_neighbor_count;       // csr entries, two per undirected edge
+    uint64_t m_obstacle_fingerprint;
+    uint64_t m_waypoints_offset;     // float[3] per waypoint
+    uint64_t m_offsets_offset;       // int32 per waypoint + 1
+    uint64_t m_indices_offset;       // int32 per csr entry
+    uint64_t m_costs_offset;         // float per csr entry
+    uint64_t m_states_offset;        // edge_state_t as uint8 per csr entry
+    float    m_max_edge_cost;
+    uint32_t m_reserved;
+};
+
+static bool is_little_endian()
+{
+    uint16_t x = 1;
+    return *reinterpret_cast<uint8_t*>(&x);
+}
+
+static uint64_t align_file_offset(uint64_t offset)
+{
+    return (offset + PRM_FILE_ALIGNMENT - 1) & ~static_cast<uint64_t>(PRM_FILE_ALIGNMENT - 1);
+}
+
+// overflow-safe check that an aligned section of count elements fits in the file
+static bool is_valid_file_section(uint64_t offset, uint64_t count, size_t elem_size, size_t size)
+{
+    return !(offset % PRM_FILE_ALIGNMENT) && offset <= size && count <= (size - offset) / elem_size;
+}
+
+// "fowler-noll-vo hash function"
+// https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+static uint64_t fnv1a_hash(const void* data, size_t size, uint64_t hash)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// edge states are shared by concurrent lazy batch queries, so every access in a search is a relaxed byte atomic
+// NOTE: two threads may check the same unknown edge at once; both store the same result
+static inline char load_edge_state(const char* edge_state)
 {
+    return __atomic_load_n(edge_state, __ATOMIC_RELAXED);
 }
 
-void PRM_Waypoint::connect(int neighbor_index, float dist)
+static inline void store_edge_state(char* edge_state, char value)
 {
-    m_neighbor_indices.insert(std::pair<int, float>(neighbor_index, dist));
+    __atomic_store_n(edge_state, value, __ATOMIC_RELAXED);
 }
 
-void PRM_Waypoint::disconnect(int neighbor_index)
+// "slab method"
+// https://en.wikipedia.org/wiki/Slab_method
+static bool is_segment_aabb_overlap(glm::vec3 p1, glm::vec3 p2, glm::vec3 min, glm::vec3 max)
+{
+    glm::vec3 dir = p2 - p1;
+    float t_min = 0;
+    float t_max = 1;
+    for(int i = 0; i < 3; i++) {
+        if(fabs(dir[i]) < EPSILON) {
+            if(p1[i] < min[i] || p1[i] > max[i]) {
+                return false;
+            }
+            continue;
+        }
+        float t1 = (min[i] - p1[i]) / dir[i];
+        float t2 = (max[i] - p1[i]) / dir[i];
+        t_min = std::max(t_min, std::min(t1, t2));
+        t_max = std::min(t_max, std::max(t1, t2));
+        if(t_min > t_max) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PRM_Waypoint::PRM_Waypoint(glm::vec3 origin)
+    : m_origin(origin)
 {
-    m_neighbor_indices.erase(neighbor_index);
 }
 
-PRM::PRM(Octree* octree)
-    : m_octree(octree)
+PRM::PRM(SpatialIndex* octree)
+    : m_octree(octree),
+      m_obstacles(octree->get_origin(), octree->get_dim()),
+      m_max_edge_cost(0),
+      m_lazy(false),
+      m_next_obstacle_id(0)
 {
 }
 
@@ -53,54 +147,35 @@ void PRM::randomize_waypoints(size_t n)
 {
     m_octree->clear();
     m_waypoints.clear();
-    glm::vec3 scatter_min = m_octree->get_origin();
-    glm::vec3 scatter_max = m_octree->get_origin() + m_octree->get_dim();
-    for(int i = 0; i < static_cast<int>(n); i++) {
-        glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX);
-        glm::vec3 origin = MIX(scatter_min, scatter_max, rand_vec);
-        m_octree->insert(i, origin);
-        PRM_Waypoint* waypoint = new PRM_Waypoint(origin);
-        m_waypoints.push_back(waypoint);
-    }
+    sample_waypoints(n);
+    build_adjacency(std::vector<std::tuple<int, int, float>>()); // no edges until connected
 }
 
 void PRM::connect_waypoints(int k, float radius)
 {
-    m_edges.clear();
-    std::set<long> unique_edges;
-    long index = 0;
-    for(std::vector<PRM_Waypoint*>::iterator p = m_waypoints.begin(); p != m_waypoints.end(); ++p) {
-        vt::PRM_Waypoint* self_object     = *p;
-        glm::vec3         self_object_pos = self_object->get_origin();
-        std::vector<long> nearest_k_indices;
-        if(m_octree->find(self_object_pos,
-                          k,
-                          &nearest_k_indices,
-                          radius))
-        {
-            glm::vec3 group_centroid(0);
-            for(std::vector<long>::iterator q = nearest_k_indices.begin(); q != nearest_k_indices.end(); ++q) {
-                if(*q == index) { // ignore self
-                    continue;
-                }
-                int min_index = std::min(index, *q);
-                int max_index = std::max(index, *q);
-                unique_edges.insert(MAKELONG(min_index, max_index));
-            }
-        }
-        index++;
+    std::vector<std::tuple<int, int, float>> edges;
+    collect_edges(0, m_waypoints.size(), k, radius, &edges);
+    build_adjacency(edges);
+    if(!m_lazy) {
+        validate_edges();
     }
-    for(std::set<long>::iterator r = unique_edges.begin(); r != unique_edges.end(); ++r) {
-        int min_index = LOWORD(*r);
-        int max_index = HIWORD(*r);
-        glm::vec3 p1 = m_waypoints[min_index]->get_origin();
-        glm::vec3 p2 = m_waypoints[max_index]->get_origin();
-        float dist = glm::distance(p1, p2);
-        m_edges.push_back(std::make_tuple(min_index, max_index, dist));
-        m_waypoints[min_index]->connect(max_index, dist);
-        m_waypoints[max_index]->connect(min_index, dist);
+}
+
+// grows the roadmap without touching existing edges; only the new waypoints are connected
+void PRM::add_waypoints(size_t n, int k, float radius)
+{
+    int first_index = m_waypoints.size();
+    sample_waypoints(n);
+    std::vector<std::tuple<int, int, float>> edges;
+    std::vector<char>                        edge_states;
+    gather_edges(&edges, &edge_states);
+    std::vector<std::tuple<int, int, float>> new_edges;
+    collect_edges(first_index, n, k, radius, &new_edges);
+    edges.insert(edges.end(), new_edges.begin(), new_edges.end());
+    edge_states.resize(edges.size(), EDGE_STATE_UNKNOWN);
+    build_adjacency(edges, &edge_states);
+    if(!m_lazy) {
+        validate_edges();
     }
 }
 
@@ -119,82 +194,126 @@ int PRM::find_nearest_waypoint(glm::vec3 pos) const
 
 bool PRM::find_shortest_path(glm::vec3 start_pos, glm::vec3 finish_pos, std::vector<int>* path)
 {
-    typedef enum { PRM_COST,
-                   PRM_FROM } export_edge_attr_t;
     if(!path) {
         return false;
     }
     int start_index  = find_nearest_waypoint(start_pos);
     int finish_index = find_nearest_waypoint(finish_pos);
-    std::vector<std::tuple<float, int>> best_cost;
-    size_t n = m_waypoints.size();
-    best_cost.reserve(n);
+    if(start_index == -1 || finish_index == -1) {
+        return false;
+    }
+    return find_path_indices(start_index, finish_index, &m_neighbor_states, &m_search_scratch, path);
+}
+
+// batch of queries over the shared roadmap; each worker thread searches with its own scratch
+// NOTE: relies on SpatialIndex const queries being safe to run concurrently, which includes lazy index rebuilds
+// NOTE: in lazy mode edge checks are stored atomically in the shared edge states, so later queries and calls reuse them
+int PRM::find_shortest_paths(const std::vector<std::pair<glm::vec3, glm::vec3>>& queries,
+                             std::vector<std::vector<int>>*                      paths) const
+{
+    if(!paths) {
+        return 0;
+    }
+    size_t n = queries.size();
+    paths->assign(n, std::vector<int>());
+    if(!n || m_waypoints.empty()) {
+        return 0;
+    }
+
+    // snap every start and finish to its nearest waypoint at once
+    std::vector<glm::vec3> endpoints(n * 2);
     for(int i = 0; i < static_cast<int>(n); i++) {
-        best_cost[i] = std::make_tuple(BIG_NUMBER, -1);
-    }
-    std::set<int> frontier;
-    std::set<int> visited;
-    frontier.insert(start_index);
-    visited.insert(start_index);
-    best_cost[start_index] = std::make_tuple(0, -1);
-    while(frontier.size()) {
-        std::set<int> new_frontier;
-        for(std::set<int>::iterator p = frontier.begin(); p != frontier.end(); ++p) {
-            int self_index = *p;
-            const std::map<int, float> &neighbor_indices = m_waypoints[*p]->get_connected();
-            for(std::map<int, float>::const_iterator q = neighbor_indices.begin(); q != neighbor_indices.end(); ++q) {
-                int other_index = (*q).first;
-                if(visited.find(other_index) != visited.end()) {
-                    continue;
-                }
-                float self_cost      = std::get<PRM_COST>(best_cost[self_index]);
-                float other_cost     = std::get<PRM_COST>(best_cost[other_index]);
-                float edge_cost      = (*q).second;
-                float new_route_cost = self_cost + edge_cost;
-                if(new_route_cost < other_cost) {
-                    best_cost[other_index] = std::make_tuple(new_route_cost, self_index);
-                }
-                new_frontier.insert(other_index);
-            }
-        }
-        visited.insert(new_frontier.begin(), new_frontier.end());
-        frontier = new_frontier;
+        endpoints[i * 2]     = queries[i].first;
+        endpoints[i * 2 + 1] = queries[i].second;
     }
-    int current_index = -1;
-    for(current_index = finish_index; current_index != start_index; current_index = std::get<PRM_FROM>(best_cost[current_index])) {
-        if(current_index == -1) {
-            return false;
+    std::vector<long> nearest_k_ids(n * 2);
+    std::vector<int>  nearest_k_offsets(n * 2 + 1);
+    m_octree->find_batch(endpoints.data(),
+                         n * 2,
+                         1,
+                         m_octree->get_dim().x,
+                         nearest_k_ids.data(),
+                         nearest_k_offsets.data());
+
+    WorkerPool* worker_pool = WorkerPool::instance();
+    std::vector<prm_search_scratch_t> thread_scratches(worker_pool->get_thread_count());
+    std::vector<char>                 found_paths(n);
+    worker_pool->run(n, [&](int thread_index, size_t begin, size_t end) {
+        prm_search_scratch_t* scratch = &thread_scratches[thread_index];
+        for(size_t i = begin; i < end; i++) {
+            int start_offset  = nearest_k_offsets[i * 2];
+            int finish_offset = nearest_k_offsets[i * 2 + 1];
+            if(start_offset == finish_offset || finish_offset == nearest_k_offsets[i * 2 + 2]) { // no nearest waypoint
+                continue;
+            }
+            found_paths[i] = find_path_indices(nearest_k_ids[start_offset],
+                                               nearest_k_ids[finish_offset],
+                                               m_lazy ? &m_neighbor_states : NULL,
+                                               scratch,
+                                               &(*paths)[i]);
         }
-        path->insert(path->begin(), current_index);
-    }
-    path->insert(path->begin(), current_index);
-    return true;
+    });
+    return std::count(found_paths.begin(), found_paths.end(), 1);
 }
 
 void PRM::prune_edges()
 {
-    for(int i = m_edges.size() - 1; i >= 0; i--) {
-        int p1_index = std::get<EXPORT_EDGE_P1>(m_edges[i]);
-        int p2_index = std::get<EXPORT_EDGE_P2>(m_edges[i]);
-        glm::vec3 p1 = m_waypoints[p1_index]->get_origin();
-        glm::vec3 p2 = m_waypoints[p2_index]->get_origin();
-        float dist = glm::distance(p1, p2);
-        if(dist < EPSILON) {
-            continue;
+    validate_edges();
+    std::vector<std::tuple<int, int, float>> edges;
+    std::vector<char>                        edge_states;
+    gather_edges(&edges, &edge_states);
+
+    // compact surviving edges in one pass
+    size_t keep_count = 0;
+    for(size_t i = 0; i < edges.size(); i++) {
+        if(edge_states[i] != EDGE_STATE_INVALID) {
+            edges[keep_count++] = edges[i];
         }
-        glm::vec3 dir = glm::normalize(p2 - p1);
-        bool is_collide = false;
-        for(std::vector<Mesh*>::iterator q = m_obstacles.begin(); q != m_obstacles.end(); ++q) {
-            if((*q)->is_ray_intersect(*q, p1, dir)) {
-                is_collide = true;
-                break;
+    }
+    edges.resize(keep_count);
+    build_adjacency(edges);
+    std::fill(m_neighbor_states.begin(), m_neighbor_states.end(), static_cast<char>(EDGE_STATE_VALID));
+}
+
+// collision checks every edge of unknown state; edges already known valid or invalid are not checked again
+int PRM::validate_edges()
+{
+    std::vector<std::pair<int, int>> edge_pairs;
+    for(int i = 0; i < static_cast<int>(m_neighbor_offsets.size()) - 1; i++) {
+        for(int j = m_neighbor_offsets[i]; j < m_neighbor_offsets[i + 1]; j++) {
+            if(m_neighbor_indices[j] < i || m_neighbor_states[j] != EDGE_STATE_UNKNOWN) { // visit each undirected edge once
+                continue;
             }
+            edge_pairs.push_back(std::make_pair(i, j));
         }
-        if(is_collide) {
-            m_edges.erase(m_edges.begin() + i);
-            m_waypoints[p1_index]->disconnect(p2_index);
-            m_waypoints[p2_index]->disconnect(p1_index);
+    }
+
+    // obstacle queries are read-only, so candidate edges are checked in parallel
+    std::vector<char> edge_states(edge_pairs.size());
+    WorkerPool::instance()->run(edge_pairs.size(), [&](int thread_index, size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            int j = edge_pairs[i].second;
+            glm::vec3 p1 = m_waypoints[edge_pairs[i].first]->get_origin();
+            glm::vec3 p2 = m_waypoints[m_neighbor_indices[j]]->get_origin();
+            bool is_valid = m_neighbor_costs[j] < EPSILON || !m_obstacles.segment_query(p1, p2);
+            edge_states[i] = is_valid ? EDGE_STATE_VALID : EDGE_STATE_INVALID;
         }
+    });
+    for(size_t i = 0; i < edge_pairs.size(); i++) {
+        set_edge_state(edge_pairs[i].first,
+                       m_neighbor_indices[edge_pairs[i].second],
+                       static_cast<edge_state_t>(edge_states[i]),
+                       &m_neighbor_states);
+    }
+    return edge_pairs.size();
+}
+
+void PRM::reset_edge_states()
+{
+    m_obstacles.update(); // pick up obstacles moved since added
+    std::fill(m_neighbor_states.begin(), m_neighbor_states.end(), static_cast<char>(EDGE_STATE_UNKNOWN));
+    if(!m_lazy) {
+        validate_edges();
     }
 }
 
@@ -217,13 +336,185 @@ bool PRM::export_edges(std::vector<std::tuple<int, int, float>>* edges) const
     if(!edges) {
         return false;
     }
-    *edges = m_edges;
+    edges->clear();
+    for(int i = 0; i < static_cast<int>(m_neighbor_offsets.size()) - 1; i++) {
+        for(int j = m_neighbor_offsets[i]; j < m_neighbor_offsets[i + 1]; j++) {
+            if(m_neighbor_indices[j] < i) { // visit each undirected edge once
+                continue;
+            }
+            if(m_neighbor_states[j] == EDGE_STATE_INVALID) { // found colliding by a lazy query
+                continue;
+            }
+            edges->push_back(std::make_tuple(i, m_neighbor_indices[j], m_neighbor_costs[j]));
+        }
+    }
+    return true;
+}
+
+// edges overlapping the obstacle may now collide; everything else keeps its state
+long PRM::add_obstacle(Mesh* obstacle)
+{
+    long id = m_next_obstacle_id++;
+    if(!m_obstacles.insert(id, obstacle)) {
+        return -1;
+    }
+    glm::vec3 _min, _max;
+    m_obstacles.get_min_max(id, &_min, &_max);
+    reset_edge_states(_min, _max, true, false);
+    if(!m_lazy) {
+        validate_edges();
+    }
+    return id;
+}
+
+// edges overlapping the old aabb may now be clear
+bool PRM::remove_obstacle(long id)
+{
+    glm::vec3 _min, _max;
+    if(!m_obstacles.get_min_max(id, &_min, &_max)) {
+        return false;
+    }
+    m_obstacles.remove(id);
+    reset_edge_states(_min, _max, false, true);
+    if(!m_lazy) {
+        validate_edges();
+    }
     return true;
 }
 
-void PRM::add_obstacle(Mesh* obstacle)
+// call after moving or reshaping an obstacle; only edges overlapping its old or new aabb are revisited
+bool PRM::update_obstacle(long id)
+{
+    glm::vec3 prev_min, prev_max;
+    if(!m_obstacles.get_min_max(id, &prev_min, &prev_max)) {
+        return false;
+    }
+    if(!m_obstacles.update(id)) { // unchanged
+        return true;
+    }
+    glm::vec3 _min, _max;
+    m_obstacles.get_min_max(id, &_min, &_max);
+    reset_edge_states(prev_min, prev_max, false, true);
+    reset_edge_states(_min, _max, true, false);
+    if(!m_lazy) {
+        validate_edges();
+    }
+    return true;
+}
+
+// hashes the world aabb of every obstacle, so a saved roadmap can tell whether it still matches the scene
+uint64_t PRM::get_obstacle_fingerprint() const
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(long id = 0; id < m_next_obstacle_id; id++) {
+        glm::vec3 _min, _max;
+        if(!m_obstacles.get_min_max(id, &_min, &_max)) {
+            continue;
+        }
+        float values[] = {_min.x, _min.y, _min.z, _max.x, _max.y, _max.z};
+        int64_t fixed_id = id; // long is 4 bytes on some platforms; keep the file format fixed width
+        hash = fnv1a_hash(&fixed_id, sizeof(fixed_id), hash);
+        hash = fnv1a_hash(values, sizeof(values), hash);
+    }
+    return hash;
+}
+
+bool PRM::save(const std::string& filename) const
 {
-    m_obstacles.push_back(obstacle);
+    if(!is_little_endian()) {
+        std::cerr << "roadmap files are little-endian only" << std::endl;
+        return false;
+    }
+    size_t n = m_waypoints.size();
+    size_t m = m_neighbor_indices.size();
+    prm_file_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_magic, PRM_FILE_MAGIC, sizeof(header.m_magic));
+    header.m_version              = PRM_FILE_VERSION;
+    header.m_header_size          = sizeof(header);
+    header.m_waypoint_count       = n;
+    header.m_neighbor_count       = m;
+    header.m_obstacle_fingerprint = get_obstacle_fingerprint();
+    header.m_waypoints_offset     = align_file_offset(sizeof(header));
+    header.m_offsets_offset       = align_file_offset(header.m_waypoints_offset + n * sizeof(glm::vec3));
+    header.m_indices_offset       = align_file_offset(header.m_offsets_offset + (n + 1) * sizeof(int32_t));
+    header.m_costs_offset         = align_file_offset(header.m_indices_offset + m * sizeof(int32_t));
+    header.m_states_offset        = align_file_offset(header.m_costs_offset + m * sizeof(float));
+    header.m_max_edge_cost        = m_max_edge_cost;
+
+    std::vector<glm::vec3> waypoint_origins(n);
+    for(int i = 0; i < static_cast<int>(n); i++) {
+        waypoint_origins[i] = m_waypoints[i]->get_origin();
+    }
+    std::vector<int32_t> neighbor_offsets(m_neighbor_offsets.begin(), m_neighbor_offsets.end());
+    neighbor_offsets.resize(n + 1, 0); // empty roadmap still has a row terminator
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if(!file) {
+        std::cerr << "cannot open file" << std::endl;
+        return false;
+    }
+    const void* sections[]      = {&header,
+                                   waypoint_origins.data(),
+                                   neighbor_offsets.data(),
+                                   m_neighbor_indices.data(),
+                                   m_neighbor_costs.data(),
+                                   m_neighbor_states.data()};
+    uint64_t    section_offsets[] = {0,
+                                     header.m_waypoints_offset,
+                                     header.m_offsets_offset,
+                                     header.m_indices_offset,
+                                     header.m_costs_offset,
+                                     header.m_states_offset};
+    size_t      section_sizes[]   = {sizeof(header),
+                                     n * sizeof(glm::vec3),
+                                     (n + 1) * sizeof(int32_t),
+                                     m * sizeof(int32_t),
+                                     m * sizeof(float),
+                                     m * sizeof(uint8_t)};
+    static const char padding[PRM_FILE_ALIGNMENT] = {};
+    uint64_t file_offset = 0;
+    bool     result      = true;
+    for(int i = 0; i < static_cast<int>(sizeof(sections) / sizeof(sections[0])) && result; i++) {
+        result = fwrite(padding, 1, section_offsets[i] - file_offset, file) == section_offsets[i] - file_offset &&
+                 fwrite(sections[i], 1, section_sizes[i], file) == section_sizes[i];
+        file_offset = section_offsets[i] + section_sizes[i];
+    }
+    if(fclose(file) || !result) {
+        std::cerr << "cannot write file" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// replaces waypoints and edges with a saved roadmap; obstacles are kept and must match the ones it was saved with
+bool PRM::load(const std::string& filename)
+{
+    if(!is_little_endian()) {
+        std::cerr << "roadmap files are little-endian only" << std::endl;
+        return false;
+    }
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd == -1) {
+        std::cerr << "cannot open file" << std::endl;
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) == -1 || static_cast<size_t>(file_stat.st_size) < sizeof(prm_file_header_t)) {
+        std::cerr << "file too small" << std::endl;
+        close(fd);
+        return false;
+    }
+    size_t file_size = file_stat.st_size;
+    void*  data      = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        std::cerr << "cannot map file" << std::endl;
+        return false;
+    }
+    bool result = load_mapped(data, file_size);
+    munmap(data, file_size);
+    return result;
 }
 
 PRM_Waypoint* PRM::at(int index) const
@@ -241,8 +532,352 @@ void PRM::clear()
         delete *p;
     }
     m_waypoints.clear();
-    m_edges.clear();
+    m_neighbor_offsets.clear();
+    m_neighbor_indices.clear();
+    m_neighbor_costs.clear();
+    m_neighbor_states.clear();
+    m_max_edge_cost = 0;
     m_obstacles.clear();
 }
 
+void PRM::sample_waypoints(size_t n)
+{
+    glm::vec3 scatter_min = m_octree->get_origin();
+    glm::vec3 scatter_max = m_octree->get_origin() + m_octree->get_dim();
+    std::vector<glm::vec3> origins(n);
+    Random::instance()->fill_uniform_vec3(origins.data(), n, scatter_min, scatter_max);
+    m_waypoints.reserve(m_waypoints.size() + n);
+    for(size_t i = 0; i < n; i++) {
+        glm::vec3 origin = origins[i];
+        m_octree->insert(m_waypoints.size(), origin);
+        PRM_Waypoint* waypoint = new PRM_Waypoint(origin);
+        m_waypoints.push_back(waypoint);
+    }
+}
+
+// connects waypoints [first_index, first_index + n) to their k nearest neighbors
+void PRM::collect_edges(int first_index, size_t n, int k, float radius, std::vector<std::tuple<int, int, float>>* edges) const
+{
+    edges->clear();
+    if(k <= 0 || !n) {
+        return;
+    }
+
+    // batch query all neighbors at once
+    std::vector<glm::vec3> waypoint_origins(n);
+    for(int i = 0; i < static_cast<int>(n); i++) {
+        waypoint_origins[i] = m_waypoints[first_index + i]->get_origin();
+    }
+    std::vector<long> nearest_k_ids(n * k);
+    std::vector<int>  nearest_k_offsets(n + 1);
+    m_octree->find_batch(waypoint_origins.data(),
+                         n,
+                         k,
+                         radius,
+                         nearest_k_ids.data(),
+                         nearest_k_offsets.data());
+
+    // collect index pairs into per-thread buffers, then merge with sort + unique
+    // NOTE: pairs are not packed into a single key so indices keep their full range
+    WorkerPool* worker_pool = WorkerPool::instance();
+    std::vector<std::vector<std::pair<int, int>>> thread_edge_pairs(worker_pool->get_thread_count());
+    worker_pool->run(n, [&](int thread_index, size_t begin, size_t end) {
+        std::vector<std::pair<int, int>>* edge_pairs = &thread_edge_pairs[thread_index];
+        for(int i = begin; i < static_cast<int>(end); i++) {
+            int index = first_index + i;
+            for(int j = nearest_k_offsets[i]; j < nearest_k_offsets[i + 1]; j++) {
+                int other_index = nearest_k_ids[j];
+                if(other_index == index) { // ignore self
+                    continue;
+                }
+                edge_pairs->push_back(std::make_pair(std::min(index, other_index), std::max(index, other_index)));
+            }
+        }
+    });
+    std::vector<std::pair<int, int>> edge_pairs;
+    for(std::vector<std::vector<std::pair<int, int>>>::iterator p = thread_edge_pairs.begin(); p != thread_edge_pairs.end(); ++p) {
+        edge_pairs.insert(edge_pairs.end(), (*p).begin(), (*p).end());
+    }
+    std::sort(edge_pairs.begin(), edge_pairs.end());
+    edge_pairs.erase(std::unique(edge_pairs.begin(), edge_pairs.end()), edge_pairs.end());
+    edges->resize(edge_pairs.size());
+    worker_pool->run(edge_pairs.size(), [&](int thread_index, size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            int min_index = edge_pairs[i].first;
+            int max_index = edge_pairs[i].second;
+            glm::vec3 p1 = m_waypoints[min_index]->get_origin();
+            glm::vec3 p2 = m_waypoints[max_index]->get_origin();
+            (*edges)[i] = std::make_tuple(min_index, max_index, glm::distance(p1, p2));
+        }
+    });
+}
+
+// like export_edges, but keeps edges known to collide and reports every edge state
+void PRM::gather_edges(std::vector<std::tuple<int, int, float>>* edges, std::vector<char>* edge_states) const
+{
+    edges->clear();
+    edge_states->clear();
+    for(int i = 0; i < static_cast<int>(m_neighbor_offsets.size()) - 1; i++) {
+        for(int j = m_neighbor_offsets[i]; j < m_neighbor_offsets[i + 1]; j++) {
+            if(m_neighbor_indices[j] < i) { // visit each undirected edge once
+                continue;
+            }
+            edges->push_back(std::make_tuple(i, m_neighbor_indices[j], m_neighbor_costs[j]));
+            edge_states->push_back(m_neighbor_states[j]);
+        }
+    }
+}
+
+void PRM::build_adjacency(const std::vector<std::tuple<int, int, float>>& edges, const std::vector<char>* edge_states)
+{
+    // counting sort edge endpoints into rows
+    size_t n = m_waypoints.size();
+    m_neighbor_offsets.assign(n + 1, 0);
+    for(std::vector<std::tuple<int, int, float>>::const_iterator p = edges.begin(); p != edges.end(); ++p) {
+        m_neighbor_offsets[std::get<EXPORT_EDGE_P1>(*p) + 1]++;
+        m_neighbor_offsets[std::get<EXPORT_EDGE_P2>(*p) + 1]++;
+    }
+    for(int i = 0; i < static_cast<int>(n); i++) {
+        m_neighbor_offsets[i + 1] += m_neighbor_offsets[i];
+    }
+    m_neighbor_indices.resize(m_neighbor_offsets[n]);
+    m_neighbor_costs.resize(m_neighbor_offsets[n]);
+    m_neighbor_states.resize(m_neighbor_offsets[n]);
+    m_max_edge_cost = 0;
+    std::vector<int> fill_offsets(m_neighbor_offsets.begin(), m_neighbor_offsets.end() - 1);
+    for(int i = 0; i < static_cast<int>(edges.size()); i++) {
+        int   p1_index   = std::get<EXPORT_EDGE_P1>(edges[i]);
+        int   p2_index   = std::get<EXPORT_EDGE_P2>(edges[i]);
+        float cost       = std::get<EXPORT_EDGE_COST>(edges[i]);
+        char  edge_state = edge_states ? (*edge_states)[i] : static_cast<char>(EDGE_STATE_UNKNOWN);
+        m_neighbor_indices[fill_offsets[p1_index]]  = p2_index;
+        m_neighbor_costs[fill_offsets[p1_index]]    = cost;
+        m_neighbor_states[fill_offsets[p1_index]++] = edge_state;
+        m_neighbor_indices[fill_offsets[p2_index]]  = p1_index;
+        m_neighbor_costs[fill_offsets[p2_index]]    = cost;
+        m_neighbor_states[fill_offsets[p2_index]++] = edge_state;
+        m_max_edge_cost = std::max(m_max_edge_cost, cost);
+    }
+}
+
+bool PRM::load_mapped(const void* data, size_t size)
+{
+    const char*              bytes  = reinterpret_cast<const char*>(data);
+    const prm_file_header_t* header = reinterpret_cast<const prm_file_header_t*>(data);
+    if(memcmp(header->m_magic, PRM_FILE_MAGIC, sizeof(header->m_magic)) ||
+            header->m_version != PRM_FILE_VERSION ||
+            header->m_header_size != sizeof(prm_file_header_t))
+    {
+        std::cerr << "not a supported roadmap file" << std::endl;
+        return false;
+    }
+    uint64_t n = header->m_waypoint_count;
+    uint64_t m = header->m_neighbor_count;
+    if(n >= static_cast<uint64_t>(INT32_MAX) || m >= static_cast<uint64_t>(INT32_MAX) ||
+            !is_valid_file_section(header->m_waypoints_offset, n,     sizeof(glm::vec3), size) ||
+            !is_valid_file_section(header->m_offsets_offset,   n + 1, sizeof(int32_t),   size) ||
+            !is_valid_file_section(header->m_indices_offset,   m,     sizeof(int32_t),   size) ||
+            !is_valid_file_section(header->m_costs_offset,     m,     sizeof(float),     size) ||
+            !is_valid_file_section(header->m_states_offset,    m,     sizeof(uint8_t),   size))
+    {
+        std::cerr << "roadmap file truncated" << std::endl;
+        return false;
+    }
+    if(header->m_obstacle_fingerprint != get_obstacle_fingerprint()) {
+        std::cerr << "roadmap file saved with different obstacles" << std::endl;
+        return false;
+    }
+    const glm::vec3* waypoint_origins = reinterpret_cast<const glm::vec3*>(bytes + header->m_waypoints_offset);
+    const int32_t*   neighbor_offsets = reinterpret_cast<const int32_t*>(bytes + header->m_offsets_offset);
+    const int32_t*   neighbor_indices = reinterpret_cast<const int32_t*>(bytes + header->m_indices_offset);
+    const float*     neighbor_costs   = reinterpret_cast<const float*>(bytes + header->m_costs_offset);
+    const uint8_t*   neighbor_states  = reinterpret_cast<const uint8_t*>(bytes + header->m_states_offset);
+
+    // reject anything that would index out of range later
+    if(neighbor_offsets[0] || neighbor_offsets[n] != static_cast<int32_t>(m)) {
+        std::cerr << "roadmap file corrupt" << std::endl;
+        return false;
+    }
+    for(uint64_t i = 0; i < n; i++) {
+        if(neighbor_offsets[i] > neighbor_offsets[i + 1]) {
+            std::cerr << "roadmap file corrupt" << std::endl;
+            return false;
+        }
+    }
+    for(uint64_t j = 0; j < m; j++) {
+        if(neighbor_indices[j] < 0 || neighbor_indices[j] >= static_cast<int32_t>(n) || neighbor_states[j] > EDGE_STATE_INVALID) {
+            std::cerr << "roadmap file corrupt" << std::endl;
+            return false;
+        }
+    }
+
+    // sections are stored in memory layout, so loading is a bulk copy
+    m_octree->clear();
+    for(std::vector<PRM_Waypoint*>::iterator p = m_waypoints.begin(); p != m_waypoints.end(); ++p) {
+        delete *p;
+    }
+    m_waypoints.clear();
+    m_waypoints.reserve(n);
+    for(int i = 0; i < static_cast<int>(n); i++) {
+        m_octree->insert(i, waypoint_origins[i]);
+        m_waypoints.push_back(new PRM_Waypoint(waypoint_origins[i]));
+    }
+    m_neighbor_offsets.assign(neighbor_offsets, neighbor_offsets + n + 1);
+    m_neighbor_indices.assign(neighbor_indices, neighbor_indices + m);
+    m_neighbor_costs.assign(neighbor_costs, neighbor_costs + m);
+    m_neighbor_states.assign(neighbor_states, neighbor_states + m);
+    m_max_edge_cost = header->m_max_edge_cost;
+    if(!m_lazy) {
+        validate_edges();
+    }
+    return true;
+}
+
+// demotes edges whose segment overlaps the aabb back to unknown
+// NOTE: an overlapping edge has both endpoints within the longest edge of the aabb, so only waypoints near it are visited
+void PRM::reset_edge_states(glm::vec3 min, glm::vec3 max, bool reset_valid, bool reset_invalid)
+{
+    glm::vec3 center = (min + max) * 0.5f;
+    float     radius = glm::distance(min, max) * 0.5f + m_max_edge_cost;
+    std::vector<long> ids(64);
+    int count = m_octree->find_within_radius(center, radius, ids.data(), ids.size());
+    if(count > static_cast<int>(ids.size())) { // retry with enough room
+        ids.resize(count);
+        count = m_octree->find_within_radius(center, radius, ids.data(), ids.size());
+    }
+    for(int i = 0; i < count; i++) {
+        int index = ids[i];
+        for(int j = m_neighbor_offsets[index]; j < m_neighbor_offsets[index + 1]; j++) {
+            char edge_state = m_neighbor_states[j];
+            if(!(reset_valid && edge_state == EDGE_STATE_VALID) && !(reset_invalid && edge_state == EDGE_STATE_INVALID)) {
+                continue;
+            }
+            int other_index = m_neighbor_indices[j];
+            if(!is_segment_aabb_overlap(m_waypoints[index]->get_origin(), m_waypoints[other_index]->get_origin(), min, max)) {
+                continue;
+            }
+            set_edge_state(index, other_index, EDGE_STATE_UNKNOWN, &m_neighbor_states);
+        }
+    }
+}
+
+// "lazy prm"
+// re-search until every edge on the best path is known to be collision free
+// NOTE: edge_states may be NULL to search the roadmap as is, without any collision checks
+bool PRM::find_path_indices(int                   start_index,
+                            int                   finish_index,
+                            std::vector<char>*    edge_states,
+                            prm_search_scratch_t* scratch,
+                            std::vector<int>*     path) const
+{
+    const std::vector<char>& search_edge_states = edge_states ? *edge_states : m_neighbor_states;
+    do {
+        if(!search_path(start_index, finish_index, search_edge_states, scratch)) {
+            return false;
+        }
+    } while(m_lazy && edge_states && !validate_path(finish_index, edge_states, scratch));
+
+    std::vector<int> reverse_path;
+    for(int current_index = finish_index; current_index != -1; current_index = scratch->m_predecessors[current_index]) {
+        reverse_path.push_back(current_index);
+    }
+    path->insert(path->begin(), reverse_path.rbegin(), reverse_path.rend());
+    return true;
+}
+
+// "a* search algorithm"
+// https://en.wikipedia.org/wiki/A*_search_algorithm
+bool PRM::search_path(int                      start_index,
+                      int                      finish_index,
+                      const std::vector<char>& edge_states,
+                      prm_search_scratch_t*    scratch) const
+{
+    // lazily invalidate scratch from previous queries by bumping the stamp
+    size_t n = m_waypoints.size();
+    if(scratch->m_g_costs.size() < n) {
+        scratch->m_g_costs.resize(n);
+        scratch->m_predecessors.resize(n);
+        scratch->m_search_stamps.resize(n, 0);
+        scratch->m_closed_stamps.resize(n, 0);
+    }
+    int search_stamp = ++scratch->m_search_stamp;
+    scratch->m_open_set.reset(n);
+
+    // euclidean heuristic is consistent with euclidean edge costs, so closed nodes never reopen
+    std::vector<float>& g_costs       = scratch->m_g_costs;
+    std::vector<int>&   predecessors  = scratch->m_predecessors;
+    std::vector<int>&   search_stamps = scratch->m_search_stamps;
+    std::vector<int>&   closed_stamps = scratch->m_closed_stamps;
+    IndexedHeap&        open_set      = scratch->m_open_set;
+    glm::vec3 finish_origin = m_waypoints[finish_index]->get_origin();
+    g_costs[start_index]       = 0;
+    predecessors[start_index]  = -1;
+    search_stamps[start_index] = search_stamp;
+    open_set.push(start_index, glm::distance(m_waypoints[start_index]->get_origin(), finish_origin));
+    while(!open_set.empty()) {
+        int self_index = open_set.pop();
+        if(self_index == finish_index) {
+            return true;
+        }
+        closed_stamps[self_index] = search_stamp;
+        float self_cost = g_costs[self_index];
+        for(int j = m_neighbor_offsets[self_index]; j < m_neighbor_offsets[self_index + 1]; j++) {
+            int other_index = m_neighbor_indices[j];
+            if(closed_stamps[other_index] == search_stamp || load_edge_state(&edge_states[j]) == EDGE_STATE_INVALID) {
+                continue;
+            }
+            float new_route_cost = self_cost + m_neighbor_costs[j];
+            if(search_stamps[other_index] == search_stamp && new_route_cost >= g_costs[other_index]) {
+                continue;
+            }
+            g_costs[other_index]       = new_route_cost;
+            predecessors[other_index]  = self_index;
+            search_stamps[other_index] = search_stamp;
+            open_set.push(other_index, new_route_cost + glm::distance(m_waypoints[other_index]->get_origin(), finish_origin));
+        }
+    }
+    return false;
+}
+
+// checks unknown edges along the last search's path; returns false on the first collision found
+bool PRM::validate_path(int finish_index, std::vector<char>* edge_states, const prm_search_scratch_t* scratch) const
+{
+    const std::vector<int>& predecessors = scratch->m_predecessors;
+    for(int current_index = finish_index; predecessors[current_index] != -1; current_index = predecessors[current_index]) {
+        int prev_index = predecessors[current_index];
+        for(int j = m_neighbor_offsets[prev_index]; j < m_neighbor_offsets[prev_index + 1]; j++) {
+            if(m_neighbor_indices[j] != current_index) {
+                continue;
+            }
+            if(load_edge_state(&(*edge_states)[j]) == EDGE_STATE_UNKNOWN) {
+                glm::vec3 p1 = m_waypoints[prev_index]->get_origin();
+                glm::vec3 p2 = m_waypoints[current_index]->get_origin();
+                bool is_valid = m_neighbor_costs[j] < EPSILON || !m_obstacles.segment_query(p1, p2);
+                set_edge_state(prev_index, current_index, is_valid ? EDGE_STATE_VALID : EDGE_STATE_INVALID, edge_states);
+                if(!is_valid) {
+                    return false;
+                }
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+void PRM::set_edge_state(int p1_index, int p2_index, edge_state_t edge_state, std::vector<char>* edge_states) const
+{
+    for(int j = m_neighbor_offsets[p1_index]; j < m_neighbor_offsets[p1_index + 1]; j++) {
+        if(m_neighbor_indices[j] == p2_index) {
+            store_edge_state(&(*edge_states)[j], edge_state);
+            break;
+        }
+    }
+    for(int j = m_neighbor_offsets[p2_index]; j < m_neighbor_offsets[p2_index + 1]; j++) {
+        if(m_neighbor_indices[j] == p1_index) {
+            store_edge_state(&(*edge_states)[j], edge_state);
+            break;
+        }
+    }
+}
+
 }
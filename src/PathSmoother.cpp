@@ -0,0 +1,189 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <PathSmoother.h>
+#include <KeyframeMgr.h>
+#include <Random.h>
+#include <Util.h>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define PATH_SMOOTHER_SAMPLES_PER_SEGMENT 16
+
+namespace vt {
+
+static float point_segment_distance(glm::vec3 point, glm::vec3 p1, glm::vec3 p2)
+{
+    glm::vec3 dir            = p2 - p1;
+    float     length_squared = glm::dot(dir, dir);
+    float     alpha          = length_squared < EPSILON ? 0 : CLAMP(glm::dot(point - p1, dir) / length_squared, 0.0f, 1.0f);
+    return glm::distance(point, p1 + dir * alpha);
+}
+
+PathSmoother::PathSmoother(const BBoxOctree* obstacles)
+    : m_obstacles(obstacles)
+{
+}
+
+int PathSmoother::shortcut_path(std::vector<glm::vec3>* path, int iterations) const
+{
+    if(!path) {
+        return 0;
+    }
+    int prev_size = path->size();
+    for(int i = 0; i < iterations && path->size() > 2; i++) {
+        int n           = path->size();
+        int first_index = Random::instance()->next_int(n);
+        int last_index  = Random::instance()->next_int(n);
+        if(first_index > last_index) {
+            std::swap(first_index, last_index);
+        }
+        if(last_index - first_index < 2) { // nothing in between
+            continue;
+        }
+        if(m_obstacles && m_obstacles->segment_query((*path)[first_index], (*path)[last_index])) {
+            continue;
+        }
+        path->erase(path->begin() + first_index + 1, path->begin() + last_index);
+    }
+    return prev_size - path->size();
+}
+
+// starts from one smooth keyframe per path point, flattens segments that fail, then greedily drops keyframes while the spline holds
+int PathSmoother::insert_keyframes(const std::vector<glm::vec3>& path,
+                                   long                          object_id,
+                                   int                           start_frame,
+                                   float                         frames_per_unit_length,
+                                   float                         tolerance,
+                                   float                         control_point_scale) const
+{
+    int n = path.size();
+    if(!n) {
+        return 0;
+    }
+    std::vector<int>  key_indices(n);
+    std::vector<bool> key_smooth(n, true);
+    for(int i = 0; i < n; i++) {
+        key_indices[i] = i;
+    }
+
+    // non-smooth keyframes have control points on their values, so a segment between two of them is the path chord itself
+    std::vector<int> bad_segments;
+    bool is_changed = true; // stops if the path itself collides
+    while(is_changed && !is_spline_valid(path, key_indices, key_smooth, tolerance, control_point_scale, 0, n - 2, &bad_segments)) {
+        is_changed = false;
+        for(std::vector<int>::iterator p = bad_segments.begin(); p != bad_segments.end(); ++p) {
+            is_changed |= key_smooth[*p] || key_smooth[*p + 1];
+            key_smooth[*p]     = false;
+            key_smooth[*p + 1] = false;
+        }
+    }
+    // dropping keyframe i only moves the control points of its neighbors, now at i - 1 and i
+    // so only the segments that use them, i - 2 through i, need another look
+    for(int i = 1; i < static_cast<int>(key_indices.size()) - 1;) {
+        int  key_index = key_indices[i];
+        bool is_smooth = key_smooth[i];
+        key_indices.erase(key_indices.begin() + i);
+        key_smooth.erase(key_smooth.begin() + i);
+        if(is_spline_valid(path, key_indices, key_smooth, tolerance, control_point_scale, i - 2, i, NULL)) {
+            continue;
+        }
+        key_indices.insert(key_indices.begin() + i, key_index);
+        key_smooth.insert(key_smooth.begin() + i, is_smooth);
+        i++;
+    }
+
+    // space keyframes by distance traveled along the path
+    float length = 0;
+    int   frame  = start_frame;
+    for(int i = 0; i < static_cast<int>(key_indices.size()); i++) {
+        if(i) {
+            for(int j = key_indices[i - 1]; j < key_indices[i]; j++) {
+                length += glm::distance(path[j], path[j + 1]);
+            }
+            frame = std::max(start_frame + static_cast<int>(length * frames_per_unit_length), frame + 1); // keep frames distinct
+        }
+        KeyframeMgr::instance()->insert_keyframe(object_id,
+                                                 MotionTrack::MOTION_TYPE_ORIGIN,
+                                                 frame,
+                                                 new Keyframe(path[key_indices[i]], key_smooth[i]));
+    }
+    return key_indices.size();
+}
+
+// samples bezier segments first_segment through last_segment, checking distance to the path points each one replaces and collisions between samples
+bool PathSmoother::is_spline_valid(const std::vector<glm::vec3>& path,
+                                   const std::vector<int>&       key_indices,
+                                   const std::vector<bool>&      key_smooth,
+                                   float                         tolerance,
+                                   float                         control_point_scale,
+                                   int                           first_segment,
+                                   int                           last_segment,
+                                   std::vector<int>*             bad_segments) const
+{
+    if(bad_segments) {
+        bad_segments->clear();
+    }
+    int key_count = key_indices.size();
+    first_segment = std::max(first_segment, 0);
+    last_segment  = std::min(last_segment, key_count - 2);
+    if(first_segment > last_segment) {
+        return true;
+    }
+
+    // only keyframes bounding the checked segments need control points
+    std::vector<Keyframe> keyframes;
+    keyframes.reserve(last_segment - first_segment + 2);
+    for(int i = first_segment; i <= last_segment + 1; i++) {
+        glm::vec3 prev_point = path[key_indices[std::max(i - 1, 0)]];
+        glm::vec3 next_point = path[key_indices[std::min(i + 1, key_count - 1)]];
+        keyframes.push_back(Keyframe(path[key_indices[i]], key_smooth[i]));
+        keyframes.back().update_control_points(prev_point, next_point, control_point_scale);
+    }
+    bool result = true;
+    for(int i = first_segment; i <= last_segment; i++) {
+        const Keyframe &keyframe      = keyframes[i - first_segment];
+        const Keyframe &next_keyframe = keyframes[i - first_segment + 1];
+        glm::vec3 p1        = keyframe.get_value();
+        glm::vec3 p2        = keyframe.get_control_point2();
+        glm::vec3 p3        = next_keyframe.get_control_point1();
+        glm::vec3 p4        = next_keyframe.get_value();
+        glm::vec3 prev_pos  = p1;
+        bool      is_valid  = true;
+        for(int j = 1; j <= PATH_SMOOTHER_SAMPLES_PER_SEGMENT && is_valid; j++) {
+            glm::vec3 pos = bezier_interpolate(p1, p2, p3, p4, static_cast<float>(j) / PATH_SMOOTHER_SAMPLES_PER_SEGMENT);
+            float dist = BIG_NUMBER;
+            for(int k = key_indices[i]; k < key_indices[i + 1]; k++) {
+                dist = std::min(dist, point_segment_distance(pos, path[k], path[k + 1]));
+            }
+            is_valid = dist <= tolerance && !(m_obstacles && m_obstacles->segment_query(prev_pos, pos));
+            prev_pos = pos;
+        }
+        if(is_valid) {
+            continue;
+        }
+        result = false;
+        if(!bad_segments) {
+            break;
+        }
+        bad_segments->push_back(i);
+    }
+    return result;
+}
+
+}
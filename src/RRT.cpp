@@ -0,0 +1,223 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <RRT.h>
+#include <Random.h>
+#include <Util.h>
+#include <algorithm>
+#include <vector>
+#include <tuple>
+#include <glm/glm.hpp>
+
+#define RRT_STEP_SIZE      0.5f
+#define RRT_MAX_ITERATIONS 5000
+
+namespace vt {
+
+RRT::RRT(glm::vec3 origin, glm::vec3 dim)
+    : m_origin(origin),
+      m_dim(dim),
+      m_start_tree(origin, dim),
+      m_finish_tree(origin, dim),
+      m_obstacles(origin, dim),
+      m_next_obstacle_id(0),
+      m_step_size(RRT_STEP_SIZE),
+      m_max_iterations(RRT_MAX_ITERATIONS)
+{
+}
+
+RRT::~RRT()
+{
+    clear();
+}
+
+// "rrt-connect: an efficient approach to single-query path planning"
+// https://www.cs.cmu.edu/afs/cs/academic/class/15494-s14/readings/kuffner_icra2000.pdf
+bool RRT::find_shortest_path(glm::vec3 start_pos, glm::vec3 finish_pos, std::vector<int>* path)
+{
+    if(!path) {
+        return false;
+    }
+    clear_trees();
+    m_obstacles.update(); // pick up obstacles moved since added
+    int start_index  = add_waypoint(0, start_pos, -1);
+    int finish_index = add_waypoint(1, finish_pos, -1);
+    if(start_index == -1 || finish_index == -1) {
+        return false;
+    }
+    if(!m_obstacles.segment_query(start_pos, finish_pos)) { // straight shot
+        build_path(start_index, finish_index, path);
+        return true;
+    }
+
+    // extend one tree toward a random sample, then greedily connect the other tree to the new node; swap roles each round
+    glm::vec3 scatter_min = m_origin;
+    glm::vec3 scatter_max = m_origin + m_dim;
+    int tree_index = 0;
+    for(int i = 0; i < m_max_iterations; i++) {
+        glm::vec3 rand_pos = Random::instance()->next_vec3(scatter_min, scatter_max);
+        int new_index = -1;
+        if(extend(tree_index, rand_pos, &new_index) != EXTEND_TRAPPED) {
+            int other_index = -1;
+            if(connect(1 - tree_index, m_waypoints[new_index]->get_origin(), &other_index) == EXTEND_REACHED) {
+                if(tree_index == 0) {
+                    build_path(new_index, other_index, path);
+                } else {
+                    build_path(other_index, new_index, path);
+                }
+                return true;
+            }
+        }
+        tree_index = 1 - tree_index;
+    }
+    return false;
+}
+
+bool RRT::export_waypoints(std::vector<glm::vec3>* waypoint_values) const
+{
+    if(!waypoint_values) {
+        return false;
+    }
+    for(std::vector<PRM_Waypoint*>::const_iterator p = m_waypoints.begin(); p != m_waypoints.end(); ++p) {
+        waypoint_values->push_back((*p)->get_origin());
+    }
+    return true;
+}
+
+// tree edges of the last query, one per non-root waypoint
+bool RRT::export_edges(std::vector<std::tuple<int, int, float>>* edges) const
+{
+    if(!edges) {
+        return false;
+    }
+    edges->clear();
+    for(int i = 0; i < static_cast<int>(m_waypoints.size()); i++) {
+        int parent_index = m_parents[i];
+        if(parent_index == -1) {
+            continue;
+        }
+        float cost = glm::distance(m_waypoints[parent_index]->get_origin(), m_waypoints[i]->get_origin());
+        edges->push_back(std::make_tuple(parent_index, i, cost));
+    }
+    return true;
+}
+
+long RRT::add_obstacle(Mesh* obstacle)
+{
+    long id = m_next_obstacle_id++;
+    if(!m_obstacles.insert(id, obstacle)) {
+        return -1;
+    }
+    return id;
+}
+
+bool RRT::remove_obstacle(long id)
+{
+    return m_obstacles.remove(id);
+}
+
+PRM_Waypoint* RRT::at(int index) const
+{
+    if(index < 0) {
+        return NULL;
+    }
+    return m_waypoints[index];
+}
+
+void RRT::clear()
+{
+    clear_trees();
+    m_obstacles.clear();
+}
+
+void RRT::clear_trees()
+{
+    m_start_tree.clear();
+    m_finish_tree.clear();
+    for(std::vector<PRM_Waypoint*>::iterator p = m_waypoints.begin(); p != m_waypoints.end(); ++p) {
+        delete *p;
+    }
+    m_waypoints.clear();
+    m_parents.clear();
+}
+
+int RRT::add_waypoint(int tree_index, glm::vec3 origin, int parent_index)
+{
+    int index = m_waypoints.size();
+    if(!get_tree(tree_index)->insert(index, origin)) {
+        return -1;
+    }
+    m_waypoints.push_back(new PRM_Waypoint(origin));
+    m_parents.push_back(parent_index);
+    return index;
+}
+
+// steps at most one step size from the nearest node toward target, provided the step is collision free
+RRT::extend_result_t RRT::extend(int tree_index, glm::vec3 target, int* new_index)
+{
+    std::vector<long> nearest_k_indices;
+    if(!get_tree(tree_index)->find(target, 1, &nearest_k_indices)) {
+        return EXTEND_TRAPPED;
+    }
+    int       nearest_index  = nearest_k_indices[0];
+    glm::vec3 nearest_origin = m_waypoints[nearest_index]->get_origin();
+    float     dist           = glm::distance(nearest_origin, target);
+    bool      is_reached     = dist <= m_step_size;
+    glm::vec3 new_origin     = is_reached ? target : nearest_origin + (target - nearest_origin) * (m_step_size / dist);
+    if(m_obstacles.segment_query(nearest_origin, new_origin)) {
+        return EXTEND_TRAPPED;
+    }
+    if(is_reached && dist < EPSILON) { // already in tree
+        *new_index = nearest_index;
+        return EXTEND_REACHED;
+    }
+    *new_index = add_waypoint(tree_index, new_origin, nearest_index);
+    if(*new_index == -1) {
+        return EXTEND_TRAPPED;
+    }
+    return is_reached ? EXTEND_REACHED : EXTEND_ADVANCED;
+}
+
+RRT::extend_result_t RRT::connect(int tree_index, glm::vec3 target, int* new_index)
+{
+    extend_result_t result;
+    do {
+        result = extend(tree_index, target, new_index);
+    } while(result == EXTEND_ADVANCED);
+    return result;
+}
+
+// start tree branch root-first, then finish tree branch leaf-first; the two meet indices share an origin
+void RRT::build_path(int start_tree_meet_index, int finish_tree_meet_index, std::vector<int>* path) const
+{
+    std::vector<int> reverse_path;
+    for(int current_index = start_tree_meet_index; current_index != -1; current_index = m_parents[current_index]) {
+        reverse_path.push_back(current_index);
+    }
+    std::vector<int> finish_path;
+    int current_index = finish_tree_meet_index;
+    if(glm::distance(m_waypoints[start_tree_meet_index]->get_origin(), m_waypoints[current_index]->get_origin()) < EPSILON) {
+        current_index = m_parents[current_index]; // skip duplicate
+    }
+    for(; current_index != -1; current_index = m_parents[current_index]) {
+        finish_path.push_back(current_index);
+    }
+    reverse_path.insert(reverse_path.begin(), finish_path.rbegin(), finish_path.rend());
+    path->insert(path->begin(), reverse_path.rbegin(), reverse_path.rend());
+}
+
+}
@@ -0,0 +1,265 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <Random.h>
+#include <WorkerPool.h>
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
+#define PHILOX_M0     0xD2511F53
+#define PHILOX_M1     0xCD9E8D57
+#define PHILOX_W0     0x9E3779B9
+#define PHILOX_W1     0xBB67AE85
+#define PHILOX_ROUNDS 10
+
+#if defined(__AVX2__)
+    #define PHILOX_LANES 8 // counter blocks per simd batch
+#elif defined(__SSE2__)
+    #define PHILOX_LANES 4
+#else
+    #define PHILOX_LANES 1
+#endif
+
+namespace vt {
+
+static std::atomic<uint64_t> global_seed(0);
+static std::atomic<int>      global_seed_generation(0);
+
+// top 24 bits map exactly onto the float mantissa
+static inline float uint_to_unit_float(uint32_t x)
+{
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+// "parallel random numbers: as easy as 1, 2, 3"
+// https://www.thesalmons.org/john/random123/papers/random123sc11.pdf
+static void philox4x32(uint64_t counter, uint64_t stream, uint64_t key, uint32_t (&result)[4])
+{
+    uint32_t c0 = static_cast<uint32_t>(counter);
+    uint32_t c1 = static_cast<uint32_t>(counter >> 32);
+    uint32_t c2 = static_cast<uint32_t>(stream);
+    uint32_t c3 = static_cast<uint32_t>(stream >> 32);
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+    for(int i = 0; i < PHILOX_ROUNDS; i++) {
+        uint64_t product0 = static_cast<uint64_t>(PHILOX_M0) * c0;
+        uint64_t product1 = static_cast<uint64_t>(PHILOX_M1) * c2;
+        uint32_t hi0 = static_cast<uint32_t>(product0 >> 32);
+        uint32_t lo0 = static_cast<uint32_t>(product0);
+        uint32_t hi1 = static_cast<uint32_t>(product1 >> 32);
+        uint32_t lo1 = static_cast<uint32_t>(product1);
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    result[0] = c0;
+    result[1] = c1;
+    result[2] = c2;
+    result[3] = c3;
+}
+
+#if defined(__AVX2__)
+// lane-wise 32x32->64 products of a and m split into high and low words
+static inline void mul_hi_lo(__m256i a, __m256i m, __m256i* hi, __m256i* lo)
+{
+    __m256i even = _mm256_mul_epu32(a, m);                        // lanes 0, 2, ..
+    __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m); // lanes 1, 3, ..
+    *lo = _mm256_unpacklo_epi32(_mm256_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                _mm256_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+    *hi = _mm256_unpacklo_epi32(_mm256_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)),
+                                _mm256_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 3, 1)));
+}
+#elif defined(__SSE2__)
+static inline void mul_hi_lo(__m128i a, __m128i m, __m128i* hi, __m128i* lo)
+{
+    __m128i even = _mm_mul_epu32(a, m);
+    __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+    *lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                             _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 2, 0)));
+    *hi = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 3, 1)),
+                             _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0, 0, 3, 1)));
+}
+#endif
+
+// blocks counter .. counter + PHILOX_LANES - 1, one per simd lane; bit-identical to philox4x32
+// NOTE: only the first three words of each block are returned, as unit floats
+static void philox4x32_lanes(uint64_t counter, uint64_t stream, uint64_t key, float (&xs)[PHILOX_LANES],
+                                                                              float (&ys)[PHILOX_LANES],
+                                                                              float (&zs)[PHILOX_LANES])
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    uint32_t counters_lo[PHILOX_LANES];
+    uint32_t counters_hi[PHILOX_LANES];
+    for(int i = 0; i < PHILOX_LANES; i++) {
+        counters_lo[i] = static_cast<uint32_t>(counter + i);
+        counters_hi[i] = static_cast<uint32_t>((counter + i) >> 32);
+    }
+    uint32_t k0 = static_cast<uint32_t>(key);
+    uint32_t k1 = static_cast<uint32_t>(key >> 32);
+#endif
+#if defined(__AVX2__)
+    __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counters_lo));
+    __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(counters_hi));
+    __m256i c2 = _mm256_set1_epi32(static_cast<uint32_t>(stream));
+    __m256i c3 = _mm256_set1_epi32(static_cast<uint32_t>(stream >> 32));
+    __m256i m0 = _mm256_set1_epi32(PHILOX_M0);
+    __m256i m1 = _mm256_set1_epi32(PHILOX_M1);
+    for(int i = 0; i < PHILOX_ROUNDS; i++) {
+        __m256i hi0, lo0, hi1, lo1;
+        mul_hi_lo(c0, m0, &hi0, &lo0);
+        mul_hi_lo(c2, m1, &hi1, &lo1);
+        c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(k0));
+        c1 = lo1;
+        c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(k1));
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f); // same mapping as uint_to_unit_float
+    _mm256_storeu_ps(xs, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c0, 8)), scale));
+    _mm256_storeu_ps(ys, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c1, 8)), scale));
+    _mm256_storeu_ps(zs, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(c2, 8)), scale));
+#elif defined(__SSE2__)
+    __m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counters_lo));
+    __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counters_hi));
+    __m128i c2 = _mm_set1_epi32(static_cast<uint32_t>(stream));
+    __m128i c3 = _mm_set1_epi32(static_cast<uint32_t>(stream >> 32));
+    __m128i m0 = _mm_set1_epi32(PHILOX_M0);
+    __m128i m1 = _mm_set1_epi32(PHILOX_M1);
+    for(int i = 0; i < PHILOX_ROUNDS; i++) {
+        __m128i hi0, lo0, hi1, lo1;
+        mul_hi_lo(c0, m0, &hi0, &lo0);
+        mul_hi_lo(c2, m1, &hi1, &lo1);
+        c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1), _mm_set1_epi32(k0));
+        c1 = lo1;
+        c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3), _mm_set1_epi32(k1));
+        c3 = lo0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+    _mm_storeu_ps(xs, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c0, 8)), scale));
+    _mm_storeu_ps(ys, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c1, 8)), scale));
+    _mm_storeu_ps(zs, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(c2, 8)), scale));
+#else
+    uint32_t result[4];
+    philox4x32(counter, stream, key, result);
+    xs[0] = uint_to_unit_float(result[0]);
+    ys[0] = uint_to_unit_float(result[1]);
+    zs[0] = uint_to_unit_float(result[2]);
+#endif
+}
+
+Random::Random(uint64_t seed, uint64_t stream)
+    : m_seed_generation(0)
+{
+    this->seed(seed, stream);
+}
+
+void Random::seed(uint64_t seed, uint64_t stream)
+{
+    m_seed         = seed;
+    m_stream       = stream;
+    m_counter      = 0;
+    m_buffer_index = 4;
+}
+
+Random* Random::instance()
+{
+    static thread_local Random random(global_seed, WorkerPool::get_thread_index()); // stable per thread
+    int seed_generation = global_seed_generation;
+    if(random.m_seed_generation != seed_generation) {
+        random.seed(global_seed, random.m_stream);
+        random.m_seed_generation = seed_generation;
+    }
+    return &random;
+}
+
+void Random::set_seed(uint64_t seed)
+{
+    global_seed = seed;
+    global_seed_generation++;
+}
+
+uint32_t Random::next_uint()
+{
+    if(m_buffer_index == 4) {
+        philox4x32(m_counter++, m_stream, m_seed, m_buffer);
+        m_buffer_index = 0;
+    }
+    return m_buffer[m_buffer_index++];
+}
+
+int Random::next_int(int n)
+{
+    if(n <= 0) {
+        return 0;
+    }
+    return static_cast<int>((static_cast<uint64_t>(next_uint()) * n) >> 32);
+}
+
+float Random::next_float()
+{
+    return uint_to_unit_float(next_uint());
+}
+
+glm::vec3 Random::next_vec3()
+{
+    uint32_t result[4];
+    philox4x32(m_counter++, m_stream, m_seed, result);
+    return glm::vec3(uint_to_unit_float(result[0]),
+                     uint_to_unit_float(result[1]),
+                     uint_to_unit_float(result[2]));
+}
+
+glm::vec3 Random::next_vec3(glm::vec3 min, glm::vec3 max)
+{
+    return min + (max - min) * next_vec3();
+}
+
+void Random::fill_uniform_vec3(glm::vec3* values, size_t n, glm::vec3 min, glm::vec3 max)
+{
+    if(!values) {
+        return;
+    }
+    uint64_t  base_counter = m_counter;
+    uint64_t  stream       = m_stream;
+    uint64_t  key          = m_seed;
+    glm::vec3 dim          = max - min;
+    WorkerPool::instance()->run(n, [&](int thread_index, size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i += PHILOX_LANES) {
+            float xs[PHILOX_LANES];
+            float ys[PHILOX_LANES];
+            float zs[PHILOX_LANES];
+            philox4x32_lanes(base_counter + i, stream, key, xs, ys, zs);
+            int lane_count = std::min(end - i, static_cast<size_t>(PHILOX_LANES)); // partial last batch
+            for(int j = 0; j < lane_count; j++) {
+                values[i + j] = min + dim * glm::vec3(xs[j], ys[j], zs[j]);
+            }
+        }
+    });
+    skip(n);
+}
+
+}
@@ -25,6 +25,7 @@
 #include <Octree.h>
 #include <Texture.h>
 #include <PrimitiveFactory.h>
+#include <Random.h>
 #include <Util.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/compatibility.hpp>
@@ -128,9 +129,9 @@ Scene::Scene()
     for(int r = 0; r < NUM_SSAO_SAMPLE_KERNELS; r++) {
         glm::vec3 offset;
         do {
-            offset = glm::vec3(m_ssao_sample_kernel_pos[r * 3 + 0] = (static_cast<float>(rand()) / RAND_MAX) * 2 - 1,
-                               m_ssao_sample_kernel_pos[r * 3 + 1] = (static_cast<float>(rand()) / RAND_MAX) * 2 - 1,
-                               m_ssao_sample_kernel_pos[r * 3 + 2] =  static_cast<float>(rand()) / RAND_MAX);
+            offset = glm::vec3(m_ssao_sample_kernel_pos[r * 3 + 0] = Random::instance()->next_float() * 2 - 1,
+                               m_ssao_sample_kernel_pos[r * 3 + 1] = Random::instance()->next_float() * 2 - 1,
+                               m_ssao_sample_kernel_pos[r * 3 + 2] =  Random::instance()->next_float());
         } while(glm::dot(glm::vec3(0, 0, 1), offset) < 0.15);
         float scale = static_cast<float>(r) / NUM_SSAO_SAMPLE_KERNELS;
         scale = glm::lerp(0.1f, 1.0f, scale * scale);
@@ -698,7 +699,10 @@ void Scene::render_lines_and_text(bool  _draw_guide_wires,
     }
 
     if(_draw_bbox && m_octree) {
-        draw_octree(m_octree, m_camera->get_transform());
+        Octree* octree = dynamic_cast<Octree*>(m_octree); // only octree nodes are drawable
+        if(octree) {
+            draw_octree(octree, m_camera->get_transform());
+        }
     }
 
     if(_draw_paths) {
@@ -19,6 +19,7 @@
 #include <NamedObject.h>
 #include <FrameObject.h>
 #include <FilePng.h>
+#include <Random.h>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <string>
@@ -370,9 +371,8 @@ void Texture::randomize(bool binary)
         case Texture::RGBA:
             {
                 size_t size_buf = size();
-                srand(time(NULL));
                 for(int i = 0; i < static_cast<int>(size_buf); i++) {
-                    m_pixels[i] = rand() % 256;
+                    m_pixels[i] = Random::instance()->next_uint() >> 24;
                 }
             }
             break;
@@ -382,7 +382,7 @@ void Texture::randomize(bool binary)
                 float* pixels = reinterpret_cast<float*>(m_pixels);
                 size_t n = m_dim.x * m_dim.y;
                 for(int i = 0; i < static_cast<int>(n); i++) {
-                    pixels[i] = (static_cast<float>(rand()) / RAND_MAX) > 0.5;
+                    pixels[i] = Random::instance()->next_float() > 0.5;
                 }
             }
             break;
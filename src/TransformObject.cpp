@@ -22,11 +22,20 @@
 #include <glm/gtx/vector_angle.hpp>
 #include <glm/glm.hpp>
 #include <set>
+#include <vector>
 
 //#define DEBUG
 
 namespace vt {
 
+// one column of the end effector position Jacobian
+struct ik_dls_column_t
+{
+    TransformObject* m_segment;
+    int              m_index;     // euler index (revolute) or origin axis (prismatic)
+    glm::vec3        m_direction; // end effector velocity per radian (revolute) or per unit (prismatic)
+};
+
 TransformObject::TransformObject(const std::string& name,
                                        glm::vec3    origin,
                                        glm::vec3    euler,
@@ -553,6 +562,109 @@ bool TransformObject::solve_ik_ccd(TransformObject* root,
     return false;
 }
 
+// "Introduction to Inverse Kinematics with Jacobian Transpose, Pseudoinverse and Damped Least Squares methods"
+// https://www.math.ucsd.edu/~sbuss/ResearchWeb/ikmethods/iksurvey.pdf
+bool TransformObject::solve_ik_dls(TransformObject* root,
+                                   glm::vec3        local_end_effector_tip,
+                                   glm::vec3        target,
+                                   glm::vec3*       end_effector_dir,
+                                   int              iters,
+                                   float            accept_end_effector_distance,
+                                   float            accept_avg_angle_distance,
+                                   float            damping)
+{
+    std::vector<ik_dls_column_t> columns;
+    for(int i = 0; i < iters; i++) {
+        TransformObject* first_segment = this;
+        if(end_effector_dir) {
+            // aim end effector segment on its own and let the rest of the chain carry it to target
+            glm::vec3 local_arc_pivot_dir;
+            float angle_delta = 0;
+            if(arcball(&local_arc_pivot_dir, &angle_delta, in_abs_system() + *end_effector_dir, in_abs_system(local_end_effector_tip))) {
+                set_local_rotation_transform(GLM_ROTATION_TRANSFORM(glm::mat4(1), -angle_delta, local_arc_pivot_dir) * get_local_rotation_transform());
+            }
+            first_segment = m_parent;
+        }
+
+        // refresh entire chain once, then read cached transforms only
+        root->get_transform();
+        glm::vec3 end_effector_tip = glm::vec3(get_transform(false) * glm::vec4(local_end_effector_tip, 1));
+        glm::vec3 error            = target - end_effector_tip;
+        if(glm::length(error) < accept_end_effector_distance) {
+            return true; // accept solution
+        }
+
+        // build Jacobian from tip to root
+        columns.clear();
+        for(TransformObject* current_segment = first_segment; current_segment && current_segment != root->get_parent(); current_segment = current_segment->get_parent()) {
+            glm::mat4 parent_transform = current_segment->m_parent ? current_segment->m_parent->get_transform(false) : glm::mat4(1);
+            if(current_segment->m_joint_type == JOINT_TYPE_PRISMATIC) {
+                for(int j = 0; j < 3; j++) {
+                    ik_dls_column_t column = {current_segment, j, glm::vec3(parent_transform[j])};
+                    columns.push_back(column);
+                }
+                continue;
+            }
+            glm::vec3 joint_origin = glm::vec3(current_segment->get_transform(false)[3]);
+            glm::vec3 offset       = end_effector_tip - joint_origin;
+            glm::mat3 parent_rotation(safe_normalize(glm::vec3(parent_transform[0])),
+                                      safe_normalize(glm::vec3(parent_transform[1])),
+                                      safe_normalize(glm::vec3(parent_transform[2])));
+
+            // yaw-pitch-roll axes, each placed by the rotations applied before it
+            const glm::vec3 &euler = current_segment->m_euler;
+            glm::vec3 axes[3];
+            axes[EULER_INDEX_YAW]   = parent_rotation * VEC_UP;
+            axes[EULER_INDEX_PITCH] = parent_rotation * glm::mat3(GLM_EULER_TRANSFORM(EULER_YAW(euler), 0, 0)) * VEC_LEFT;
+            axes[EULER_INDEX_ROLL]  = parent_rotation * glm::mat3(GLM_EULER_TRANSFORM(EULER_YAW(euler), EULER_PITCH(euler), 0)) * VEC_FORWARD;
+            for(int j = 0; j < 3; j++) {
+                if(current_segment->is_hinge() && j != current_segment->m_hinge_type) {
+                    continue;
+                }
+                ik_dls_column_t column = {current_segment, j, glm::cross(axes[j], offset)};
+                columns.push_back(column);
+            }
+        }
+        if(columns.empty()) {
+            return false;
+        }
+
+        // joint deltas = J^T * (J * J^T + damping^2 * I)^-1 * error
+        glm::mat3 jacobian_jacobian_transpose(damping * damping);
+        for(std::vector<ik_dls_column_t>::iterator p = columns.begin(); p != columns.end(); ++p) {
+            jacobian_jacobian_transpose += glm::outerProduct((*p).m_direction, (*p).m_direction);
+        }
+        glm::vec3 weighted_error = glm::inverse(jacobian_jacobian_transpose) * error;
+
+        // apply from root down so that hinge recalibration sees each parent's final pose
+        int segment_count = 0;
+        float sum_angle = 0;
+        for(std::vector<ik_dls_column_t>::reverse_iterator p = columns.rbegin(); p != columns.rend();) {
+            TransformObject* current_segment = (*p).m_segment;
+            if(current_segment->m_joint_type == JOINT_TYPE_PRISMATIC) {
+                glm::vec3 origin = current_segment->get_origin();
+                for(; p != columns.rend() && (*p).m_segment == current_segment; ++p) {
+                    origin[(*p).m_index] += glm::dot((*p).m_direction, weighted_error);
+                }
+                current_segment->set_origin(origin); // projects onto joint constraints
+                continue;
+            }
+            glm::vec3 euler = current_segment->get_euler();
+            for(; p != columns.rend() && (*p).m_segment == current_segment; ++p) {
+                float angle_delta = glm::degrees(glm::dot((*p).m_direction, weighted_error));
+                euler[(*p).m_index] += angle_delta;
+                sum_angle += fabs(angle_delta);
+            }
+            current_segment->set_euler(euler); // projects onto joint constraints
+            segment_count++;
+        }
+        if(segment_count && sum_angle / segment_count < accept_avg_angle_distance) {
+            return true; // reach local minima
+        }
+    }
+    return glm::distance(in_abs_system(local_end_effector_tip), target) < accept_end_effector_distance;
+}
+
 void TransformObject::update_boid(glm::vec3 target,
                                   float     forward_speed,
                                   float     angle_delta,
@@ -0,0 +1,121 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <WorkerPool.h>
+#include <algorithm>
+
+#define CHUNKS_PER_THREAD 4 // finer chunks balance uneven per-index cost
+
+namespace vt {
+
+static thread_local int current_thread_index = 0;
+
+WorkerPool::WorkerPool()
+    : m_n(0),
+      m_grain_size(1),
+      m_next_index(0),
+      m_generation(0),
+      m_busy_count(0),
+      m_shutdown(false)
+{
+    int thread_count = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    for(int i = 1; i < thread_count; i++) {
+        m_threads.push_back(std::thread(&WorkerPool::worker_loop, this, i));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+    }
+    m_start_cv.notify_all();
+    for(std::vector<std::thread>::iterator p = m_threads.begin(); p != m_threads.end(); ++p) {
+        (*p).join();
+    }
+}
+
+void WorkerPool::run(size_t n, task_t task, size_t grain_size)
+{
+    if(!n) {
+        return;
+    }
+    int thread_count = get_thread_count();
+    if(!grain_size) {
+        grain_size = std::max(n / (thread_count * CHUNKS_PER_THREAD), static_cast<size_t>(1));
+    }
+    if(thread_count == 1 || n <= grain_size) { // not worth waking workers
+        task(0, 0, n);
+        return;
+    }
+    std::unique_lock<std::mutex> run_lock(m_run_mutex); // one batch at a time
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_task       = task;
+        m_n          = n;
+        m_grain_size = grain_size;
+        m_next_index = 0;
+        m_busy_count = m_threads.size();
+        m_generation++;
+    }
+    m_start_cv.notify_all();
+    run_chunks(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this]{ return !m_busy_count; });
+    m_task = task_t();
+}
+
+int WorkerPool::get_thread_index()
+{
+    return current_thread_index;
+}
+
+void WorkerPool::worker_loop(int thread_index)
+{
+    current_thread_index = thread_index;
+    int generation = 0;
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cv.wait(lock, [this, generation]{ return m_shutdown || m_generation != generation; });
+            if(m_shutdown) {
+                return;
+            }
+            generation = m_generation;
+        }
+        run_chunks(thread_index);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_busy_count--;
+        }
+        m_done_cv.notify_one();
+    }
+}
+
+void WorkerPool::run_chunks(int thread_index)
+{
+    for(;;) {
+        size_t begin = m_next_index.fetch_add(m_grain_size);
+        if(begin >= m_n) {
+            return;
+        }
+        m_task(thread_index, begin, std::min(begin + m_grain_size, m_n));
+    }
+}
+
+}
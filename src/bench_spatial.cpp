@@ -0,0 +1,255 @@
+// This file is part of dexvt-lite.
+// -- 3D Inverse Kinematics (Cyclic Coordinate Descent) with Constraints
+// Copyright (C) 2018 onlyuser <mailto:onlyuser@gmail.com>
+//
+// dexvt-lite is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// dexvt-lite is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with dexvt-lite.  If not, see <http://www.gnu.org/licenses/>.
+
+// headless timing harness for SpatialIndex implementations
+// usage: bench_spatial [csv|json] [max_size]
+
+#include <glm/glm.hpp>
+#include <HashGrid.h>
+#include <LinearOctree.h>
+#include <Octree.h>
+#include <SpatialIndex.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream> // std::cout
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_ORIGIN          glm::vec3(-5)
+#define BENCH_DIM             glm::vec3(10)
+#define BENCH_CELL_SIZE       0.25f
+#define BENCH_SEED            1234
+#define BENCH_MIN_SIZE        1000
+#define BENCH_MAX_SIZE        1000000
+#define BENCH_QUERY_COUNT     1000
+#define BENCH_K               8
+#define BENCH_RADIUS          0.25f
+#define BENCH_MOVE_STEP       0.05f
+#define BENCH_CLUSTER_COUNT   16
+#define BENCH_CLUSTER_SPREAD  0.25f
+#define BENCH_RADIUS_CAPACITY 4096
+
+#ifndef BENCH_BUILD_FLAGS
+    #define BENCH_BUILD_FLAGS "unknown" // set by the makefile; timings are only comparable at equal flags
+#endif
+
+enum dist_type_t {
+    DIST_UNIFORM,
+    DIST_CLUSTERED,
+    DIST_MOVING
+};
+
+struct bench_result_t
+{
+    std::string m_index_name;
+    std::string m_dist_name;
+    size_t      m_size;
+    std::string m_op_name;
+    double      m_total_ms;
+    size_t      m_op_count;
+};
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+static double elapsed_ms(bench_clock_t::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock_t::now() - start).count();
+}
+
+static const char* get_dist_name(dist_type_t dist_type)
+{
+    switch(dist_type) {
+        case DIST_UNIFORM:   return "uniform";
+        case DIST_CLUSTERED: return "clustered";
+        case DIST_MOVING:    return "moving";
+    }
+    return "";
+}
+
+static void generate_points(dist_type_t dist_type, size_t n, std::mt19937* rng, std::vector<glm::vec3>* points)
+{
+    glm::vec3 _min = BENCH_ORIGIN;
+    glm::vec3 _max = BENCH_ORIGIN + BENCH_DIM;
+    std::uniform_real_distribution<float> uniform(0, 1);
+    points->resize(n);
+    if(dist_type == DIST_CLUSTERED) {
+        std::vector<glm::vec3> centers(BENCH_CLUSTER_COUNT);
+        for(int i = 0; i < BENCH_CLUSTER_COUNT; i++) {
+            centers[i] = _min + BENCH_DIM * glm::vec3(uniform(*rng), uniform(*rng), uniform(*rng));
+        }
+        std::normal_distribution<float> normal(0, BENCH_CLUSTER_SPREAD);
+        for(size_t i = 0; i < n; i++) {
+            glm::vec3 pos = centers[i % BENCH_CLUSTER_COUNT] + glm::vec3(normal(*rng), normal(*rng), normal(*rng));
+            (*points)[i] = glm::clamp(pos, _min, _max);
+        }
+        return;
+    }
+    for(size_t i = 0; i < n; i++) {
+        (*points)[i] = _min + BENCH_DIM * glm::vec3(uniform(*rng), uniform(*rng), uniform(*rng));
+    }
+}
+
+static void bench_index(vt::SpatialIndex*            index,
+                        const std::string&           index_name,
+                        dist_type_t                  dist_type,
+                        const std::vector<glm::vec3>& points,
+                        const std::vector<glm::vec3>& targets,
+                        std::mt19937*                rng,
+                        std::vector<bench_result_t>* results)
+{
+    size_t n = points.size();
+    bench_result_t result;
+    result.m_index_name = index_name;
+    result.m_dist_name  = get_dist_name(dist_type);
+    result.m_size       = n;
+
+    // insert
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for(size_t i = 0; i < n; i++) {
+        index->insert(i, points[i]);
+    }
+    index->rebalance();
+    result.m_op_name  = "insert";
+    result.m_total_ms = elapsed_ms(start);
+    result.m_op_count = n;
+    results->push_back(result);
+
+    // move + rebalance (moving set walks every point; static sets re-submit in place)
+    std::vector<glm::vec3> moved_points(points);
+    if(dist_type == DIST_MOVING) {
+        std::uniform_real_distribution<float> step(-BENCH_MOVE_STEP, BENCH_MOVE_STEP);
+        for(size_t i = 0; i < n; i++) {
+            moved_points[i] = glm::clamp(moved_points[i] + glm::vec3(step(*rng), step(*rng), step(*rng)),
+                                         BENCH_ORIGIN,
+                                         BENCH_ORIGIN + BENCH_DIM);
+        }
+    }
+    start = bench_clock_t::now();
+    for(size_t i = 0; i < n; i++) {
+        index->move(i, moved_points[i]);
+    }
+    index->rebalance();
+    result.m_op_name  = "move_rebalance";
+    result.m_total_ms = elapsed_ms(start);
+    result.m_op_count = n;
+    results->push_back(result);
+
+    // knn
+    std::vector<long> nearest_k_vec;
+    start = bench_clock_t::now();
+    for(size_t i = 0; i < targets.size(); i++) {
+        nearest_k_vec.clear();
+        index->find(targets[i], BENCH_K, &nearest_k_vec);
+    }
+    result.m_op_name  = "find";
+    result.m_total_ms = elapsed_ms(start);
+    result.m_op_count = targets.size();
+    results->push_back(result);
+
+    // radius
+    static long ids[BENCH_RADIUS_CAPACITY];
+    start = bench_clock_t::now();
+    for(size_t i = 0; i < targets.size(); i++) {
+        index->find_within_radius(targets[i], BENCH_RADIUS, ids, BENCH_RADIUS_CAPACITY);
+    }
+    result.m_op_name  = "find_within_radius";
+    result.m_total_ms = elapsed_ms(start);
+    result.m_op_count = targets.size();
+    results->push_back(result);
+
+    // clear
+    start = bench_clock_t::now();
+    index->clear();
+    result.m_op_name  = "clear";
+    result.m_total_ms = elapsed_ms(start);
+    result.m_op_count = 1;
+    results->push_back(result);
+}
+
+static void print_csv(const std::vector<bench_result_t>& results)
+{
+    std::cout << "index,dist,size,op,total_ms,ops,ns_per_op,flags" << std::endl;
+    for(std::vector<bench_result_t>::const_iterator p = results.begin(); p != results.end(); ++p) {
+        std::cout << (*p).m_index_name << ","
+                  << (*p).m_dist_name  << ","
+                  << (*p).m_size       << ","
+                  << (*p).m_op_name    << ","
+                  << (*p).m_total_ms   << ","
+                  << (*p).m_op_count   << ","
+                  << (*p).m_total_ms * 1000000 / std::max((*p).m_op_count, static_cast<size_t>(1)) << ","
+                  << BENCH_BUILD_FLAGS << std::endl;
+    }
+}
+
+static void print_json(const std::vector<bench_result_t>& results)
+{
+    std::cout << "[" << std::endl;
+    for(std::vector<bench_result_t>::const_iterator p = results.begin(); p != results.end(); ++p) {
+        std::cout << "    {\"index\": \""   << (*p).m_index_name << "\", "
+                  << "\"dist\": \""         << (*p).m_dist_name  << "\", "
+                  << "\"size\": "           << (*p).m_size       << ", "
+                  << "\"op\": \""           << (*p).m_op_name    << "\", "
+                  << "\"total_ms\": "       << (*p).m_total_ms   << ", "
+                  << "\"ops\": "            << (*p).m_op_count   << ", "
+                  << "\"ns_per_op\": "      << (*p).m_total_ms * 1000000 / std::max((*p).m_op_count, static_cast<size_t>(1)) << ", "
+                  << "\"flags\": \""        << BENCH_BUILD_FLAGS << "\"}"
+                  << (p + 1 != results.end() ? "," : "") << std::endl;
+    }
+    std::cout << "]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bool   use_json = argc > 1 && !strcmp(argv[1], "json");
+    size_t max_size = argc > 2 ? strtoul(argv[2], NULL, 10) : BENCH_MAX_SIZE;
+
+    std::vector<bench_result_t> results;
+    dist_type_t dist_types[] = {DIST_UNIFORM, DIST_CLUSTERED, DIST_MOVING};
+    for(size_t n = BENCH_MIN_SIZE; n <= max_size; n *= 10) {
+        for(int i = 0; i < static_cast<int>(sizeof(dist_types) / sizeof(dist_types[0])); i++) {
+            dist_type_t dist_type = dist_types[i];
+
+            // same points and targets for every index
+            std::mt19937 rng(BENCH_SEED);
+            std::vector<glm::vec3> points;
+            std::vector<glm::vec3> targets;
+            generate_points(dist_type, n, &rng, &points);
+            generate_points(DIST_UNIFORM, BENCH_QUERY_COUNT, &rng, &targets);
+
+            vt::Octree octree(BENCH_ORIGIN, BENCH_DIM);
+            std::mt19937 octree_rng(BENCH_SEED);
+            bench_index(&octree, "Octree", dist_type, points, targets, &octree_rng, &results);
+
+            vt::LinearOctree linear_octree(BENCH_ORIGIN, BENCH_DIM);
+            std::mt19937 linear_octree_rng(BENCH_SEED);
+            bench_index(&linear_octree, "LinearOctree", dist_type, points, targets, &linear_octree_rng, &results);
+
+            vt::HashGrid hash_grid(BENCH_ORIGIN, BENCH_DIM, BENCH_CELL_SIZE);
+            std::mt19937 hash_grid_rng(BENCH_SEED);
+            bench_index(&hash_grid, "HashGrid", dist_type, points, targets, &hash_grid_rng, &results);
+        }
+    }
+    if(use_json) {
+        print_json(results);
+    } else {
+        print_csv(results);
+    }
+    return 0;
+}
@@ -38,9 +38,11 @@
 #include <glm/gtx/vector_angle.hpp>
 #include <shader_utils.h>
 
+#include <BBoxOctree.h>
 #include <Buffer.h>
 #include <Camera.h>
 #include <Octree.h>
+#include <OctreeSnapshot.h>
 #include <File3ds.h>
 #include <FrameBuffer.h>
 #include <Light.h>
@@ -50,6 +52,7 @@
 #include <Octree.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
+#include <Random.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
@@ -90,9 +93,12 @@
 #define BOID_FORWARD_SPEED_MIN                    0.025f
 #define BOID_FORWARD_SPEED_MAX                    0.05f
 #define BOID_LIDAR_FOV                            15.0f
-#define BOID_NEAREST_NEIGHBOR_COUNT               5
+#define BOID_NEIGHBOR_CAPACITY                    32 // initial; grows to the largest neighborhood seen
 #define OCTREE_ORIGIN                             glm::vec3(-5)
 #define OCTREE_DIM                                glm::vec3(10)
+#define OCTREE_LOOSENESS                          1.5f
+
+#define RANDOM_SEED time(NULL) // set to a constant for reproducible runs
 
 //#define DEBUG 1
 
@@ -102,6 +108,8 @@ int init_screen_width  = 800,
     init_screen_height = 600;
 vt::Camera  *camera         = NULL;
 vt::Octree  *octree         = NULL;
+vt::OctreeSnapshot *octree_snapshot = NULL;
+vt::BBoxOctree *obstacle_octree = NULL;
 vt::Mesh    *mesh_skybox    = NULL,
             *box            = NULL;
 vt::Light   *light          = NULL,
@@ -158,13 +166,11 @@ static void randomize_meshes(std::vector<vt::Mesh*>* meshes,
                              glm::vec3               scatter_max)
 {
     for(std::vector<vt::Mesh*>::iterator p = meshes->begin(); p != meshes->end(); ++p) {
-        glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX);
+        glm::vec3 rand_vec = vt::Random::instance()->next_vec3();
         (*p)->set_origin(MIX(scatter_min, scatter_max, rand_vec));
-        (*p)->set_euler(glm::vec3(-180 + static_cast<float>(rand()) / RAND_MAX * 360,
-                                  -90  + static_cast<float>(rand()) / RAND_MAX * 90,
-                                  -180 + static_cast<float>(rand()) / RAND_MAX * 360));
+        (*p)->set_euler(glm::vec3(-180 + vt::Random::instance()->next_float() * 360,
+                                  -90  + vt::Random::instance()->next_float() * 90,
+                                  -180 + vt::Random::instance()->next_float() * 360));
     }
 }
 
@@ -177,7 +183,7 @@ static void randomize_boids(std::vector<vt::Mesh*>* boid_meshes,
                      scatter_max);
     size_t boid_count = boid_meshes->size();
     for(int i = 0; i < static_cast<int>(boid_count); i++) {
-        boid_speeds[i] = BOID_FORWARD_SPEED_MIN + (BOID_FORWARD_SPEED_MAX - BOID_FORWARD_SPEED_MIN) * static_cast<float>(rand()) / RAND_MAX;
+        boid_speeds[i] = BOID_FORWARD_SPEED_MIN + (BOID_FORWARD_SPEED_MAX - BOID_FORWARD_SPEED_MIN) * vt::Random::instance()->next_float();
     }
 }
 
@@ -192,7 +198,7 @@ static void create_boids(vt::Scene*              scene,
     if(!scene || !boid_meshes) {
         return;
     }
-    srand(time(NULL));
+    vt::Random::set_seed(RANDOM_SEED);
     for(int i = 0; i < boid_count; i++) {
         std::stringstream ss;
         ss << i;
@@ -223,15 +229,13 @@ static void create_obstacles(vt::Scene*              scene,
     if(!scene || !obstacle_meshes) {
         return;
     }
-    srand(time(NULL));
+    vt::Random::set_seed(RANDOM_SEED);
     for(int i = 0; i < obstacle_count; i++) {
         std::stringstream ss;
         ss << name << "_" << i;
         vt::Mesh* mesh = vt::PrimitiveFactory::create_box(ss.str());
         mesh->center_axis();
-        glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX);
+        glm::vec3 rand_vec = vt::Random::instance()->next_vec3();
         mesh->set_scale(MIX(dim_min, dim_max, rand_vec));
         mesh->flatten();
         mesh->center_axis();
@@ -285,7 +289,9 @@ int init_resources()
     camera = new vt::Camera("camera", origin + glm::vec3(0, 0, orbit_radius), origin);
     scene->set_camera(camera);
     octree = new vt::Octree(OCTREE_ORIGIN, OCTREE_DIM);
+    octree->set_looseness(OCTREE_LOOSENESS);
     scene->set_octree(octree);
+    octree_snapshot = new vt::OctreeSnapshot();
     box = vt::PrimitiveFactory::create_box("octree", OCTREE_DIM.x, OCTREE_DIM.y, OCTREE_DIM.z);
     box->center_axis();
     box->set_origin(glm::vec3(0));
@@ -332,6 +338,13 @@ int init_resources()
     // NOTE: must add last!
     obstacle_meshes.push_back(box);
 
+    obstacle_octree = new vt::BBoxOctree(OCTREE_ORIGIN, OCTREE_DIM);
+    long obstacle_index = 0;
+    for(std::vector<vt::Mesh*>::iterator p = obstacle_meshes.begin(); p != obstacle_meshes.end(); ++p) {
+        obstacle_octree->insert(obstacle_index, *p);
+        obstacle_index++;
+    }
+
     scene->m_debug_targets.push_back(std::make_tuple(targets[target_index], glm::vec3(1, 0, 1), 1, 1));
 
     return 1;
@@ -384,17 +397,18 @@ void onTick()
         glm::vec3 self_object_pos = box->wrap(self_object->get_origin());
         self_object->set_origin(self_object_pos);
 
-        // add/update
-        if(octree->exists(index)) {
-            octree->move(index, self_object_pos);
-        } else {
+        // add/update (relocates incrementally; no rebalance needed)
+        if(!octree->move(index, self_object_pos)) {
             octree->insert(index, self_object_pos);
         }
         index++;
     }
 
-    // rebalance
-    octree->rebalance();
+    // freeze this frame's positions; neighbor queries below read the snapshot, not the live tree
+    octree_snapshot->build(octree);
+
+    // pick up obstacles moved since last tick
+    obstacle_octree->update();
 
     long index2 = 0;
     for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); ++p) {
@@ -422,51 +436,33 @@ void onTick()
                                                                                               lateral_offset * sin(glm::radians(330.0f)),
                                                                                               BIG_NUMBER)) - self_object->in_abs_system());
 
-        for(std::vector<vt::Mesh*>::iterator q = obstacle_meshes.begin(); q != obstacle_meshes.end(); ++q) {
-            vt::Mesh* obstacle_mesh = *q;
-
-            float nearest_distance       = BIG_NUMBER;
-            float nearest_distance_up    = BIG_NUMBER;
-            float nearest_distance_left  = BIG_NUMBER;
-            float nearest_distance_right = BIG_NUMBER;
-
-            // forward
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            self_object->get_abs_heading(),
-                                            &nearest_distance);
-
-            // up
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            nearest_dir_up,
-                                            &nearest_distance_up);
-
-            // left
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            nearest_dir_left,
-                                            &nearest_distance_left);
-
-            // right
-            obstacle_mesh->is_ray_intersect(obstacle_mesh,
-                                            self_object->in_abs_system(),
-                                            nearest_dir_right,
-                                            &nearest_distance_right);
-
-            if(nearest_distance < min_nearest_distance) {
-                min_nearest_distance = nearest_distance;
-            }
-            if(nearest_distance_up < min_nearest_distance_up) {
-                min_nearest_distance_up = nearest_distance_up;
-            }
-            if(nearest_distance_left < min_nearest_distance_left) {
-                min_nearest_distance_left = nearest_distance_left;
-            }
-            if(nearest_distance_right < min_nearest_distance_right) {
-                min_nearest_distance_right = nearest_distance_right;
-            }
-        }
+        // forward
+        obstacle_octree->raycast(self_object->in_abs_system(),
+                                 self_object->get_abs_heading(),
+                                 BIG_NUMBER,
+                                 NULL,
+                                 &min_nearest_distance);
+
+        // up
+        obstacle_octree->raycast(self_object->in_abs_system(),
+                                 nearest_dir_up,
+                                 BIG_NUMBER,
+                                 NULL,
+                                 &min_nearest_distance_up);
+
+        // left
+        obstacle_octree->raycast(self_object->in_abs_system(),
+                                 nearest_dir_left,
+                                 BIG_NUMBER,
+                                 NULL,
+                                 &min_nearest_distance_left);
+
+        // right
+        obstacle_octree->raycast(self_object->in_abs_system(),
+                                 nearest_dir_right,
+                                 BIG_NUMBER,
+                                 NULL,
+                                 &min_nearest_distance_right);
 
         //self_object->m_debug_lines.push_back(std::pair<glm::vec3, glm::vec3>(self_object->in_abs_system(),
         //                                                                     self_object->in_abs_system(glm::vec3(0, 0, min_nearest_distance))));
@@ -522,21 +518,39 @@ void onTick()
                 self_object->set_ambient_color(glm::vec3(1, 0, 1)); // magenta
             }
         } else {
-            // flocking behavior
-            std::vector<long> nearest_k_indices;
+            // flocking behavior (unsorted neighbors within radius)
+            static std::vector<long>  neighbor_ids(BOID_NEIGHBOR_CAPACITY);
+            static std::vector<float> neighbor_dists_squared(BOID_NEIGHBOR_CAPACITY);
+            int neighbor_count = octree_snapshot->find_within_radius(self_object_pos,
+                                                                     BOID_NEAREST_NEIGHBOR_RADIUS,
+                                                                     neighbor_ids.data(),
+                                                                     neighbor_ids.size(),
+                                                                     neighbor_dists_squared.data());
+            if(neighbor_count > static_cast<int>(neighbor_ids.size())) { // retry with enough room rather than keep an arbitrary subset
+                neighbor_ids.resize(neighbor_count);
+                neighbor_dists_squared.resize(neighbor_count);
+                neighbor_count = octree_snapshot->find_within_radius(self_object_pos,
+                                                                     BOID_NEAREST_NEIGHBOR_RADIUS,
+                                                                     neighbor_ids.data(),
+                                                                     neighbor_ids.size(),
+                                                                     neighbor_dists_squared.data());
+            }
             bool boid_updated = false;
-            if(octree->find(self_object_pos,
-                            BOID_NEAREST_NEIGHBOR_COUNT,
-                            &nearest_k_indices,
-                            BOID_NEAREST_NEIGHBOR_RADIUS))
-            {
+            if(neighbor_count) {
                 glm::vec3 group_centroid(0);
                 glm::vec3 average_heading(0);
                 size_t valid_neighbor_count = 0;
-                for(std::vector<long>::iterator q = nearest_k_indices.begin(); q != nearest_k_indices.end(); ++q) {
+                long   nearest_other_index        = -1;
+                float  nearest_other_dist_squared = BIG_NUMBER;
+                for(int j = 0; j < neighbor_count; j++) {
+                    const long* q = &neighbor_ids[j];
                     if(*q == index2) { // ignore self
                         continue;
                     }
+                    if(neighbor_dists_squared[j] < nearest_other_dist_squared) {
+                        nearest_other_index        = *q;
+                        nearest_other_dist_squared = neighbor_dists_squared[j];
+                    }
                     vt::Mesh* other_object         = boid_meshes[*q];
                     glm::vec3 other_object_pos     = other_object->get_origin();
                     glm::vec3 other_object_heading = other_object->get_abs_heading();
@@ -551,8 +565,8 @@ void onTick()
                         valid_neighbor_count++;
                     }
                 }
-                if(nearest_k_indices.size() >= 2) {
-                    vt::Mesh* nearest_other_object     = boid_meshes[nearest_k_indices[1]];
+                if(nearest_other_index != -1) {
+                    vt::Mesh* nearest_other_object     = boid_meshes[nearest_other_index];
                     glm::vec3 nearest_other_object_pos = nearest_other_object->get_origin();
 
                     if(glm::distance(self_object_pos, nearest_other_object_pos) < BOID_AVOID_RADIUS) {
@@ -63,12 +63,15 @@
 
 #define ACCEPT_AVG_ANGLE_DISTANCE    0.001
 #define ACCEPT_END_EFFECTOR_DISTANCE 0.001
+#define IK_DAMPING                   0.1
 #define IK_ITERS                     5
 #define IK_SEGMENT_COUNT             5
 #define IK_SEGMENT_HEIGHT            0.25
 #define IK_SEGMENT_LENGTH            1
 #define IK_SEGMENT_WIDTH             0.25
 
+//#define IK_DLS // damped least squares instead of ccd
+
 const char* DEFAULT_CAPTION = "";
 
 int init_screen_width  = 800,
@@ -311,6 +314,16 @@ void onTick()
                 end_effector_euler = glm::vec3(0, -1, 0);
             }
         }
+#ifdef IK_DLS
+        ik_meshes[IK_SEGMENT_COUNT - 1]->solve_ik_dls(ik_meshes[1],
+                                                      glm::vec3(0, 0, IK_SEGMENT_LENGTH),
+                                                      targets[target_index],
+                                                      angle_constraint ? &end_effector_euler : NULL,
+                                                      IK_ITERS,
+                                                      ACCEPT_END_EFFECTOR_DISTANCE,
+                                                      ACCEPT_AVG_ANGLE_DISTANCE,
+                                                      IK_DAMPING);
+#else
         ik_meshes[IK_SEGMENT_COUNT - 1]->solve_ik_ccd(ik_meshes[1],
                                                       glm::vec3(0, 0, IK_SEGMENT_LENGTH),
                                                       targets[target_index],
@@ -318,6 +331,7 @@ void onTick()
                                                       IK_ITERS,
                                                       ACCEPT_END_EFFECTOR_DISTANCE,
                                                       ACCEPT_AVG_ANGLE_DISTANCE);
+#endif
         user_input = false;
     }
     static int angle = 0;
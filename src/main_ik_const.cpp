@@ -47,6 +47,7 @@
 #include <Modifiers.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
+#include <Random.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
@@ -70,6 +71,8 @@
 #define IK_SEGMENT_LENGTH            1
 #define IK_SEGMENT_WIDTH             0.25
 
+#define RANDOM_SEED time(NULL) // set to a constant for reproducible runs
+
 const char* DEFAULT_CAPTION = "";
 
 int init_screen_width  = 800,
@@ -561,7 +564,7 @@ int main(int argc, char* argv[])
 #endif
 
     DEFAULT_CAPTION = argv[0];
-    srand(time(NULL));
+    vt::Random::set_seed(RANDOM_SEED);
 
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_RGBA | GLUT_ALPHA | GLUT_DOUBLE | GLUT_DEPTH /*| GLUT_STENCIL*/);
@@ -50,6 +50,7 @@
 #include <Octree.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
+#include <Random.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
@@ -72,18 +73,25 @@
 #define BOID_INIT_SCATTER_MAX glm::vec3(5)
 #define BOID_INIT_SCATTER_MIN glm::vec3(-5)
 
-#define BOID_ANGLE_DELTA            2.5f
-#define BOID_FORWARD_SPEED_MIN      0.0125f
-#define BOID_FORWARD_SPEED_MAX      0.025f
-#define BOID_NEAREST_NEIGHBOR_COUNT 20
-#define OCTREE_ORIGIN               glm::vec3(-5)
-#define OCTREE_DIM                  glm::vec3(10)
+#define BOID_ANGLE_DELTA                  2.5f
+#define BOID_FORWARD_SPEED_MIN            0.0125f
+#define BOID_FORWARD_SPEED_MAX            0.025f
+#define BOID_NEAREST_NEIGHBOR_COUNT       20
+#define BOID_NEAREST_NEIGHBOR_EPS         0.25f // approximate knn is plenty for a heatmap
+#define BOID_NEAREST_NEIGHBOR_LEAF_BUDGET 8
+#define OCTREE_ORIGIN                     glm::vec3(-5)
+#define OCTREE_DIM                        glm::vec3(10)
+#define OCTREE_LOOSENESS                  1.5f
 
 #define GRAVITATIONAL_CONSTANT 0.00001f
+#define BARNES_HUT_THETA       0.5f
+#define BARNES_HUT_SOFTENING   0.05f
 
 #define HEATMAP_NEAR_DIST 0
 #define HEATMAP_FAR_DIST  5
 
+#define RANDOM_SEED time(NULL) // set to a constant for reproducible runs
+
 //#define DEBUG 1
 
 const char* DEFAULT_CAPTION = "";
@@ -148,13 +156,9 @@ static void randomize_boids(std::vector<vt::Mesh*>* meshes,
 {
     size_t boid_count = meshes->size();
     for(int i = 0; i < static_cast<int>(boid_count); i++) {
-        glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX);
+        glm::vec3 rand_vec = vt::Random::instance()->next_vec3();
         boid_origin[i] = MIX(scatter_min, scatter_max, rand_vec);
-        glm::vec3 rand_vec2(static_cast<float>(rand()) / RAND_MAX,
-                            static_cast<float>(rand()) / RAND_MAX,
-                            static_cast<float>(rand()) / RAND_MAX);
+        glm::vec3 rand_vec2 = vt::Random::instance()->next_vec3();
         boid_velocity[i] = MIX(glm::vec3(-BOID_FORWARD_SPEED_MAX), glm::vec3(BOID_FORWARD_SPEED_MAX), rand_vec2);
     }
 }
@@ -170,7 +174,7 @@ static void create_boids(vt::Scene*              scene,
     if(!scene || !boid_meshes) {
         return;
     }
-    srand(time(NULL));
+    vt::Random::set_seed(RANDOM_SEED);
     for(int i = 0; i < boid_count; i++) {
         std::stringstream ss;
         ss << i;
@@ -257,6 +261,8 @@ int init_resources()
     camera = new vt::Camera("camera", origin + glm::vec3(0, 0, orbit_radius), origin);
     scene->set_camera(camera);
     octree = new vt::Octree(OCTREE_ORIGIN, OCTREE_DIM);
+    octree->set_track_mass(true);
+    octree->set_looseness(OCTREE_LOOSENESS);
     scene->set_octree(octree);
     box = vt::PrimitiveFactory::create_box("octree", OCTREE_DIM.x, OCTREE_DIM.y, OCTREE_DIM.z);
     box->center_axis();
@@ -341,17 +347,26 @@ void onTick()
         glm::vec3 self_object_pos = boid_origin[index];
         self_object->set_origin(self_object_pos);
 
-        // add/update
-        if(octree->exists(index)) {
-            octree->move(index, self_object_pos);
-        } else {
+        // add/update (relocates incrementally; no rebalance needed)
+        if(!octree->move(index, self_object_pos)) {
             octree->insert(index, self_object_pos);
         }
         index++;
     }
 
-    // rebalance
-    octree->rebalance();
+    // batch query all neighbors at once (for visualization only)
+    static long nearest_k_ids[BOID_COUNT * BOID_NEAREST_NEIGHBOR_COUNT];
+    static int  nearest_k_offsets[BOID_COUNT + 1];
+    if(show_paths) {
+        octree->find_batch_approx(boid_origin,
+                                  boid_meshes.size(),
+                                  BOID_NEAREST_NEIGHBOR_COUNT,
+                                  BOID_NEAREST_NEIGHBOR_RADIUS,
+                                  BOID_NEAREST_NEIGHBOR_EPS,
+                                  BOID_NEAREST_NEIGHBOR_LEAF_BUDGET,
+                                  nearest_k_ids,
+                                  nearest_k_offsets);
+    }
 
     long index2 = 0;
     for(std::vector<vt::Mesh*>::iterator p = boid_meshes.begin(); p != boid_meshes.end(); ++p) {
@@ -360,42 +375,29 @@ void onTick()
 
         self_object->m_debug_lines.clear();
 
-        // flocking behavior
-        std::vector<long> nearest_k_indices;
-        if(octree->find(self_object_pos,
-                        BOID_NEAREST_NEIGHBOR_COUNT,
-                        &nearest_k_indices,
-                        BOID_NEAREST_NEIGHBOR_RADIUS))
-        {
-            glm::vec3 group_centroid(0);
-            for(std::vector<long>::iterator q = nearest_k_indices.begin(); q != nearest_k_indices.end(); ++q) {
+        // heatmap
+        if(show_paths) {
+            const long* nearest_k_indices = nearest_k_ids + nearest_k_offsets[index2];
+            int         nearest_k_count   = nearest_k_offsets[index2 + 1] - nearest_k_offsets[index2];
+            for(const long* q = nearest_k_indices; q != nearest_k_indices + nearest_k_count; ++q) {
                 if(*q == index2) { // ignore self
                     continue;
                 }
                 vt::Mesh* other_object     = boid_meshes[*q];
                 glm::vec3 other_object_pos = other_object->get_origin();
-
-                // collect stats
-                group_centroid += other_object_pos;
                 float dist = glm::distance(self_object_pos, other_object_pos);
                 glm::vec3 color = lerp_heatmap(dist, HEATMAP_NEAR_DIST, HEATMAP_FAR_DIST, true);
                 self_object->m_debug_lines.push_back(std::make_tuple(self_object_pos, other_object_pos, color, 1));
             }
-            if(nearest_k_indices.size()) {
-                group_centroid *= (1.0f / nearest_k_indices.size());
-                float mass = nearest_k_indices.size();
-                float dist = glm::distance(group_centroid, self_object_pos);
-                if(dist < EPSILON) {
-                    index2++;
-                    continue;
-                }
-                float force = GRAVITATIONAL_CONSTANT * mass / pow(dist, 2);
-                boid_velocity[index2] += vt::safe_normalize(group_centroid - self_object_pos) * force;
-
-                // apply speed limit
-                boid_velocity[index2] = vt::safe_normalize(boid_velocity[index2]) * std::min(glm::length(boid_velocity[index2]), BOID_FORWARD_SPEED_MAX);
-            }
         }
+
+        // gravity from all other boids (barnes-hut approximation)
+        glm::vec3 force = octree->accumulate_force(self_object_pos, BARNES_HUT_THETA, BARNES_HUT_SOFTENING) * GRAVITATIONAL_CONSTANT;
+        boid_velocity[index2] += force;
+
+        // apply speed limit
+        boid_velocity[index2] = vt::safe_normalize(boid_velocity[index2]) * std::min(glm::length(boid_velocity[index2]), BOID_FORWARD_SPEED_MAX);
+
         boid_origin[index2] += boid_velocity[index2];
         index2++;
     }
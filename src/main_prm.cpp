@@ -50,8 +50,10 @@
 #include <Modifiers.h>
 #include <Octree.h>
 #include <PRM.h>
+#include <PathSmoother.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
+#include <Random.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
@@ -83,7 +85,14 @@
 #define WAYPOINT_NEAREST_NEIGHBOR_COUNT  10
 #define WAYPOINT_NEAREST_NEIGHBOR_RADIUS 5
 
-#define FRAMES_PER_SEGMENT 40
+#define FRAMES_PER_UNIT_LENGTH     20
+#define PATH_SHORTCUT_ITERATIONS   100
+#define PATH_SMOOTHING_TOLERANCE   0.25f
+#define PATH_CONTROL_POINT_SCALE   0.5f
+
+//#define PRM_CACHE_FILE "prm_cache.bin"
+
+#define RANDOM_SEED time(NULL) // set to a constant for reproducible runs
 
 //#define DEBUG 1
 
@@ -151,13 +160,11 @@ static void randomize_meshes(std::vector<vt::Mesh*>* meshes,
                              glm::vec3               scatter_max)
 {
     for(std::vector<vt::Mesh*>::iterator p = meshes->begin(); p != meshes->end(); ++p) {
-        glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX);
+        glm::vec3 rand_vec = vt::Random::instance()->next_vec3();
         (*p)->set_origin(MIX(scatter_min, scatter_max, rand_vec));
-        (*p)->set_euler(glm::vec3(-180 + static_cast<float>(rand()) / RAND_MAX * 360,
-                                  -90  + static_cast<float>(rand()) / RAND_MAX * 90,
-                                  -180 + static_cast<float>(rand()) / RAND_MAX * 360));
+        (*p)->set_euler(glm::vec3(-180 + vt::Random::instance()->next_float() * 360,
+                                  -90  + vt::Random::instance()->next_float() * 90,
+                                  -180 + vt::Random::instance()->next_float() * 360));
     }
 }
 
@@ -173,15 +180,13 @@ static void create_obstacles(vt::Scene*              scene,
     if(!scene || !obstacle_meshes) {
         return;
     }
-    srand(time(NULL));
+    vt::Random::set_seed(RANDOM_SEED);
     for(int i = 0; i < obstacle_count; i++) {
         std::stringstream ss;
         ss << name << "_" << i;
         vt::Mesh* mesh = vt::PrimitiveFactory::create_box(ss.str());
         mesh->center_axis();
-        glm::vec3 rand_vec(static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX,
-                           static_cast<float>(rand()) / RAND_MAX);
+        glm::vec3 rand_vec = vt::Random::instance()->next_vec3();
         mesh->set_scale(MIX(dim_min, dim_max, rand_vec));
         mesh->flatten();
         mesh->center_axis();
@@ -201,12 +206,22 @@ static void randomize_prm(vt::Scene*              scene,
                           std::vector<vt::Mesh*>* obstacle_meshes)
 {
     prm->clear();
-    prm->randomize_waypoints(n);
-    prm->connect_waypoints(k, radius);
     for(std::vector<vt::Mesh*>::iterator t = obstacle_meshes->begin(); t != obstacle_meshes->end(); ++t) {
         prm->add_obstacle(*t);
     }
+#ifdef PRM_CACHE_FILE
+    // NOTE: only reused while the obstacles match the ones it was saved with
+    if(!prm->load(PRM_CACHE_FILE)) {
+        prm->randomize_waypoints(n);
+        prm->connect_waypoints(k, radius);
+        prm->prune_edges();
+        prm->save(PRM_CACHE_FILE);
+    }
+#else
+    prm->randomize_waypoints(n);
+    prm->connect_waypoints(k, radius);
     prm->prune_edges();
+#endif
 
     scene->m_debug_targets.clear();
     scene->m_debug_targets.push_back(std::make_tuple(targets[target_index], glm::vec3(1, 0, 1), 4, 2));
@@ -246,14 +261,21 @@ static void update_target(glm::vec3 target)
     if(prm->find_shortest_path(glm::vec3(0), nearest_waypoint->get_origin(), &path) && path.size() > 1) {
         vt::KeyframeMgr::instance()->clear();
         long object_id = 0;
-        int frame = 0;
+        std::vector<glm::vec3> path_origins;
         for(std::vector<int>::iterator p = path.begin(); p != path.end(); ++p) {
             path_indices.insert(*p);
-            vt::KeyframeMgr::instance()->insert_keyframe(object_id, vt::MotionTrack::MOTION_TYPE_ORIGIN, frame, new vt::Keyframe(prm->at(*p)->get_origin(), true));
-            frame += FRAMES_PER_SEGMENT;
+            path_origins.push_back(prm->at(*p)->get_origin());
         }
-        vt::KeyframeMgr::instance()->insert_keyframe(object_id, vt::MotionTrack::MOTION_TYPE_ORIGIN, frame, new vt::Keyframe(targets[target_index], true));
-        vt::KeyframeMgr::instance()->update_control_points(0.5);
+        path_origins.push_back(targets[target_index]);
+        vt::PathSmoother path_smoother(prm->get_obstacles());
+        path_smoother.shortcut_path(&path_origins, PATH_SHORTCUT_ITERATIONS);
+        path_smoother.insert_keyframes(path_origins,
+                                       object_id,
+                                       0,
+                                       FRAMES_PER_UNIT_LENGTH,
+                                       PATH_SMOOTHING_TOLERANCE,
+                                       PATH_CONTROL_POINT_SCALE);
+        vt::KeyframeMgr::instance()->update_control_points(PATH_CONTROL_POINT_SCALE);
         std::vector<glm::vec3> &origin_frame_values = vt::Scene::instance()->m_debug_object_context[object_id].m_debug_origin_frame_values;
         origin_frame_values.clear();
         vt::KeyframeMgr::instance()->export_frame_values_for_object(object_id, &origin_frame_values, NULL, NULL, true);
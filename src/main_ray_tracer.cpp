@@ -49,6 +49,7 @@
 #include <Modifiers.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
+#include <Random.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
@@ -80,6 +81,8 @@
 #define BLUR_ITERS            5
 #define GLOW_CUTOFF_THRESHOLD 0.9
 
+#define RANDOM_SEED time(NULL) // set to a constant for reproducible runs
+
 const char* DEFAULT_CAPTION = "";
 
 int init_screen_width  = 800,
@@ -349,11 +352,11 @@ int init_resources()
 
     scene->m_ray_tracer_render_mode = 2;
 
-    srand(time(NULL));
+    vt::Random::set_seed(RANDOM_SEED);
     for(int i = 0; i < MAX_RANDOM_POINTS; i++) {
-        scene->m_ray_tracer_random_points.push_back(glm::normalize(glm::vec3((static_cast<float>(rand()) / RAND_MAX) * 2 - 1,
-                                                                             (static_cast<float>(rand()) / RAND_MAX) * 2 - 1,
-                                                                             (static_cast<float>(rand()) / RAND_MAX) * 2 - 1)));
+        scene->m_ray_tracer_random_points.push_back(glm::normalize(glm::vec3(vt::Random::instance()->next_float() * 2 - 1,
+                                                                             vt::Random::instance()->next_float() * 2 - 1,
+                                                                             vt::Random::instance()->next_float() * 2 - 1)));
     }
     scene->m_ray_tracer_random_point_count = MAX_RANDOM_POINTS;
     scene->m_ray_tracer_random_seed = 0;
@@ -49,6 +49,7 @@
 #include <Modifiers.h>
 #include <PrimitiveFactory.h>
 #include <Program.h>
+#include <Random.h>
 #include <Scene.h>
 #include <Shader.h>
 #include <ShaderContext.h>
@@ -335,9 +336,9 @@ static void update_leg_targets(glm::vec2               center,
     }
     for(std::vector<glm::vec3>::iterator q = leg_targets->begin(); q != leg_targets->end(); ++q) {
         if(is_invalid_target(*q)) { // only update illegal targets
-            float rand_angle = (static_cast<float>(rand()) / RAND_MAX) * (2 * PI);
+            float rand_angle = vt::Random::instance()->next_float() * (2 * PI);
             glm::vec2 rand_dir = vt::safe_normalize(glm::vec2(cos(rand_angle), sin(rand_angle)));
-            float rand_radius = inner_radius + (static_cast<float>(rand()) / RAND_MAX) * (outer_radius - inner_radius);
+            float rand_radius = inner_radius + vt::Random::instance()->next_float() * (outer_radius - inner_radius);
             glm::vec2 leg_target = center + rand_dir * rand_radius;
             leg_target = limit_to_within_terrain(leg_target, width, length);
             (*q).x = leg_target.x;